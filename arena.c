@@ -0,0 +1,88 @@
+#define _GNU_SOURCE //MAP_HUGETLB, MADV_HUGEPAGE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/mman.h>
+
+#include "arena.h"
+#include "stats.h"
+
+struct PageArena {
+   uint32_t frame_size;
+   bool huge_pages;
+   void** chunks;
+   uint32_t num_chunks;
+   uint32_t chunks_capacity;
+   void* next_frame;     //当前块里还没切出去的部分
+   void* chunk_end;
+   void* free_list;      //释放的页帧，前8个字节存下一个空闲页帧
+};
+
+PageArena* arena_open(uint32_t frame_size, bool huge_pages) {
+   PageArena* arena = malloc(sizeof(PageArena));
+   arena->frame_size = frame_size;
+   arena->huge_pages = huge_pages;
+   arena->chunks = NULL;
+   arena->num_chunks = 0;
+   arena->chunks_capacity = 0;
+   arena->next_frame = NULL;
+   arena->chunk_end = NULL;
+   arena->free_list = NULL;
+   return arena;
+}
+
+void arena_add_chunk(PageArena* arena) {
+   void* chunk = MAP_FAILED;
+   if (arena->huge_pages) {
+      chunk = mmap(NULL, ARENA_CHUNK_SIZE, PROT_READ | PROT_WRITE,
+                   MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+   }
+   if (chunk == MAP_FAILED) {
+      chunk = mmap(NULL, ARENA_CHUNK_SIZE, PROT_READ | PROT_WRITE,
+                   MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+      if (chunk == MAP_FAILED) {
+         printf("Error allocating page arena\n");
+         exit(EXIT_FAILURE);
+      }
+      if (arena->huge_pages) {
+         madvise(chunk, ARENA_CHUNK_SIZE, MADV_HUGEPAGE);
+      }
+   }
+
+   if (arena->num_chunks == arena->chunks_capacity) {
+      arena->chunks_capacity = arena->chunks_capacity ? arena->chunks_capacity * 2 : 16;
+      arena->chunks = realloc(arena->chunks, arena->chunks_capacity * sizeof(void*));
+      STAT_INC(STAT_HEAP_ALLOCATIONS);
+   }
+   arena->chunks[arena->num_chunks++] = chunk;
+   arena->next_frame = chunk;
+   arena->chunk_end = chunk + ARENA_CHUNK_SIZE;
+   STAT_INC(STAT_ARENA_CHUNKS);
+}
+
+void* arena_alloc(PageArena* arena) {
+   if (arena->free_list != NULL) {
+      void* frame = arena->free_list;
+      arena->free_list = *(void**)frame;
+      return frame;
+   }
+   if (arena->next_frame == NULL || arena->next_frame + arena->frame_size > arena->chunk_end) {
+      arena_add_chunk(arena);
+   }
+   void* frame = arena->next_frame;
+   arena->next_frame += arena->frame_size;
+   return frame;
+}
+
+void arena_free(PageArena* arena, void* frame) {
+   *(void**)frame = arena->free_list;
+   arena->free_list = frame;
+}
+
+void arena_close(PageArena* arena) {
+   for (uint32_t i = 0; i < arena->num_chunks; i++) {
+      munmap(arena->chunks[i], ARENA_CHUNK_SIZE);
+   }
+   free(arena->chunks);
+   free(arena);
+}
@@ -0,0 +1,24 @@
+#ifndef MYDB_ARENA_H
+#define MYDB_ARENA_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/*
+   页帧分配器：pager 的所有页帧都从大块内存里按页大小切出来，
+   不再每次缓存未命中都 malloc 一页。块按系统页对齐，页帧自然满足 O_DIRECT 的对齐要求。
+   释放的页帧挂在空闲链表上复用，整块内存只在关闭时归还
+*/
+
+#define ARENA_CHUNK_SIZE (2 * 1024 * 1024) //和透明大页一样大
+
+typedef struct PageArena PageArena;
+
+//huge_pages 为 true 时先尝试 MAP_HUGETLB，不行再用普通内存加 MADV_HUGEPAGE
+PageArena* arena_open(uint32_t frame_size, bool huge_pages);
+void* arena_alloc(PageArena* arena);
+void arena_free(PageArena* arena, void* frame);
+//归还所有块，之前分配的页帧全部失效
+void arena_close(PageArena* arena);
+
+#endif
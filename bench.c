@@ -0,0 +1,192 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <fcntl.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "mydb.h"
+
+/*
+   用同一套负载比较不同页大小：
+      bench [行数] [点查询次数] [db文件目录] [sync|uring|threads] [direct]
+   每种页大小新建一个db文件，乱序插入后关闭再打开，
+   然后做两次全表扫描(第一次前先把文件踢出系统页缓存，要从磁盘读页；第二次全部命中缓存)和随机点查询
+*/
+
+#define BENCH_PAYLOAD_SIZE 100
+
+const uint32_t bench_page_sizes[] = {4096, 8192, 16384, 32768, 65536};
+
+double bench_now_ms(void) {
+   struct timespec ts;
+   clock_gettime(CLOCK_MONOTONIC, &ts);
+   return ts.tv_sec * 1000.0 + ts.tv_nsec / 1000000.0;
+}
+
+//线性同余发生器，保证每种页大小的插入顺序和查询序列都一样
+uint64_t bench_random(uint64_t* state) {
+   *state = *state * 6364136223846793005ull + 1442695040888963407ull;
+   return *state >> 33;
+}
+
+void bench_exec(Database* db, const char* sql) {
+   Statement* statement;
+   if (db_prepare(db, sql, &statement) != PREPARE_SUCCESS) {
+      printf("Bench statement failed to prepare: %s\n", sql);
+      exit(EXIT_FAILURE);
+   }
+   ExecuteResult result = db_step(statement);
+   db_finalize(statement);
+   if (result != EXECUTE_SUCCESS) {
+      printf("Bench statement failed: %s\n", sql);
+      exit(EXIT_FAILURE);
+   }
+}
+
+Database* bench_open(const char* filename, const DatabaseOptions* options) {
+   Database* db;
+   if (db_open_with_options(filename, options, &db) != DB_OK) {
+      printf("Unable to open bench db %s\n", filename);
+      exit(EXIT_FAILURE);
+   }
+   return db;
+}
+
+void bench_close(Database* db) {
+   if (db_close(db) != DB_OK) {
+      printf("Error closing bench db.\n");
+      exit(EXIT_FAILURE);
+   }
+}
+
+//把db文件写到磁盘并踢出系统页缓存，之后的读才是真正的冷读
+void bench_evict(const char* filename) {
+   int fd = open(filename, O_RDONLY);
+   if (fd == -1) {
+      printf("Unable to open bench db %s\n", filename);
+      exit(EXIT_FAILURE);
+   }
+   fdatasync(fd); //脏页踢不掉，先写回
+   posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+   close(fd);
+}
+
+//返回扫描到的行数
+uint64_t bench_scan(Database* db) {
+   Statement* statement;
+   db_prepare(db, "select * from bench", &statement);
+   uint64_t rows = 0;
+   while (db_step(statement) == EXECUTE_ROW) {
+      rows++;
+   }
+   db_finalize(statement);
+   return rows;
+}
+
+int main(int argc, char* argv[]) {
+   uint32_t num_rows = argc > 1 ? (uint32_t)strtoul(argv[1], NULL, 10) : 100000;
+   uint32_t num_lookups = argc > 2 ? (uint32_t)strtoul(argv[2], NULL, 10) : 100000;
+   const char* directory = argc > 3 ? argv[3] : ".";
+
+   DatabaseOptions options;
+   db_default_options(&options);
+   if (argc > 4 && strcmp(argv[4], "uring") == 0) {
+      options.io_backend = DB_IO_URING;
+   } else if (argc > 4 && strcmp(argv[4], "threads") == 0) {
+      options.io_backend = DB_IO_THREADS;
+   }
+   options.direct_io = argc > 5 && strcmp(argv[5], "direct") == 0;
+
+   if (num_rows == 0) {
+      num_lookups = 0; //空表上没有可查的 id
+   }
+
+   //id 从1开始，乱序插入，每种页大小用同一个顺序
+   uint64_t* ids = malloc(num_rows * sizeof(uint64_t));
+   for (uint32_t i = 0; i < num_rows; i++) {
+      ids[i] = i + 1;
+   }
+   uint64_t state = 42;
+   for (uint32_t i = num_rows; i > 1; i--) {
+      uint32_t j = bench_random(&state) % i;
+      uint64_t swap = ids[i - 1];
+      ids[i - 1] = ids[j];
+      ids[j] = swap;
+   }
+
+   printf("%d rows, %d point lookups, payload char(%d)\n", num_rows, num_lookups, BENCH_PAYLOAD_SIZE);
+   printf("%10s %10s %10s %12s %12s %14s %10s\n",
+          "page_size", "insert_ms", "file_mb", "cold_scan_ms", "warm_scan_ms", "lookup_ns", "rows/s");
+
+   char filename[1024];
+   char sql[256];
+   for (uint32_t p = 0; p < sizeof(bench_page_sizes) / sizeof(bench_page_sizes[0]); p++) {
+      uint32_t page_size = bench_page_sizes[p];
+      snprintf(filename, sizeof(filename), "%s/bench_%u.db", directory, page_size);
+      unlink(filename);
+
+      options.page_size = page_size;
+      Database* db = bench_open(filename, &options);
+      bench_exec(db, "create table bench (id bigint, payload char(100))");
+
+      double start = bench_now_ms();
+      for (uint32_t i = 0; i < num_rows; i++) {
+         snprintf(sql, sizeof(sql), "insert into bench %llu payload%llu",
+                  (unsigned long long)ids[i], (unsigned long long)ids[i]);
+         bench_exec(db, sql);
+      }
+      double insert_ms = bench_now_ms() - start;
+      bench_close(db);
+
+      bench_evict(filename);
+      db = bench_open(filename, &options);
+      start = bench_now_ms();
+      uint64_t scanned = bench_scan(db);
+      double cold_scan_ms = bench_now_ms() - start;
+      start = bench_now_ms();
+      bench_scan(db);
+      double warm_scan_ms = bench_now_ms() - start;
+      if (scanned != num_rows) {
+         printf("Scan returned %llu rows, expected %u\n", (unsigned long long)scanned, num_rows);
+         exit(EXIT_FAILURE);
+      }
+
+      state = 7;
+      uint32_t found = 0;
+      start = bench_now_ms();
+      for (uint32_t i = 0; i < num_lookups; i++) {
+         uint64_t id = bench_random(&state) % num_rows + 1;
+         snprintf(sql, sizeof(sql), "select * from bench where id = %llu", (unsigned long long)id);
+         Statement* statement;
+         db_prepare(db, sql, &statement);
+         while (db_step(statement) == EXECUTE_ROW) {
+            found++;
+         }
+         db_finalize(statement);
+      }
+      double lookup_ms = bench_now_ms() - start;
+      if (found != num_lookups) {
+         printf("Point lookups found %u rows, expected %u\n", found, num_lookups);
+         exit(EXIT_FAILURE);
+      }
+      bench_close(db);
+
+      FILE* file = fopen(filename, "rb");
+      fseek(file, 0, SEEK_END);
+      double file_mb = ftell(file) / (1024.0 * 1024.0);
+      fclose(file);
+      unlink(filename);
+
+      printf("%10u %10.1f %10.1f %12.2f %12.2f %14.0f %10.0f\n",
+             page_size, insert_ms, file_mb, cold_scan_ms, warm_scan_ms,
+             num_lookups ? lookup_ms * 1000000.0 / num_lookups : 0.0,
+             warm_scan_ms > 0 ? num_rows / (warm_scan_ms / 1000.0) : 0.0);
+   }
+
+   free(ids);
+   return 0;
+}
@@ -0,0 +1,484 @@
+#define _GNU_SOURCE //O_DIRECT
+
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <linux/io_uring.h>
+
+#include "io.h"
+#include "stats.h"
+
+#define IO_URING_ENTRIES 256
+#define IO_THREAD_COUNT 4
+
+typedef enum {
+   IO_READ,
+   IO_WRITE
+} IoOperation;
+
+/*
+   io_uring 的共享内存环，没有 liburing，直接用系统调用和 mmap
+*/
+typedef struct {
+   int ring_fd;
+   uint32_t entries;
+   void* sq_ring;
+   size_t sq_ring_size;
+   void* cq_ring;
+   size_t cq_ring_size;
+   struct io_uring_sqe* sqes;
+   size_t sqes_size;
+   uint32_t* sq_tail;
+   uint32_t* sq_mask;
+   uint32_t* sq_array;
+   uint32_t* cq_head;
+   uint32_t* cq_tail;
+   uint32_t* cq_mask;
+   struct io_uring_cqe* cqes;
+} IoUring;
+
+/*
+   线程池：主线程发布一批请求后等待，工作线程各自领取请求执行
+*/
+typedef struct {
+   pthread_t threads[IO_THREAD_COUNT];
+   pthread_mutex_t lock;
+   pthread_cond_t work_ready;
+   pthread_cond_t work_done;
+   IoRequest* batch;
+   IoOperation operation;
+   uint32_t batch_count;
+   uint32_t next;        //下一个待领取的请求
+   uint32_t completed;
+   int error;            //第一个失败请求的 errno
+   bool shutdown;
+} IoThreadPool;
+
+struct IoContext {
+   int fd;
+   DbIoBackend backend;
+   IoUring ring;
+   bool ring_open;       //环建好了就一直留到 io_close，退回同步读写后也一样
+   IoThreadPool pool;
+};
+
+const char* io_backend_name(DbIoBackend backend) {
+   switch (backend) {
+      case (DB_IO_URING):
+         return "io_uring";
+      case (DB_IO_THREADS):
+         return "threads";
+      case (DB_IO_SYNC):
+      default:
+         return "sync";
+   }
+}
+
+int io_open_file(const char* filename, bool direct, bool* direct_enabled) {
+   int fd = -1;
+   *direct_enabled = false;
+   if (direct) {
+      fd = open(filename, O_RDWR | O_CREAT | O_DIRECT, S_IWUSR | S_IRUSR);
+      *direct_enabled = fd != -1;
+   }
+   if (fd == -1) {
+      fd = open(filename, O_RDWR | O_CREAT, S_IWUSR | S_IRUSR);
+   }
+   return fd;
+}
+
+void* io_alloc_buffer(uint32_t size) {
+   void* buffer;
+   if (posix_memalign(&buffer, IO_BUFFER_ALIGNMENT, size) != 0) {
+      printf("Error allocating io buffer\n");
+      exit(EXIT_FAILURE);
+   }
+   return buffer;
+}
+
+/*
+   同步读写整个请求，短读说明到了文件末尾，剩下的填0。
+   返回0成功，否则返回 errno
+*/
+int io_transfer(int fd, IoOperation operation, IoRequest* request, uint32_t done) {
+   while (done < request->length) {
+      ssize_t bytes;
+      if (operation == IO_READ) {
+         bytes = pread(fd, request->buffer + done, request->length - done, request->offset + done);
+         STAT_INC(STAT_READ_SYSCALL);
+      } else {
+         bytes = pwrite(fd, request->buffer + done, request->length - done, request->offset + done);
+         STAT_INC(STAT_WRITE_SYSCALL);
+      }
+      if (bytes == -1) {
+         if (errno == EINTR) {
+            continue;
+         }
+         return errno;
+      }
+      if (bytes == 0) {
+         if (operation == IO_WRITE) {
+            return EIO;
+         }
+         memset(request->buffer + done, 0, request->length - done);
+         return 0;
+      }
+      done += bytes;
+   }
+   return 0;
+}
+
+bool io_uring_init(IoUring* ring) {
+   struct io_uring_params params;
+   memset(&params, 0, sizeof(params));
+   int ring_fd = syscall(__NR_io_uring_setup, IO_URING_ENTRIES, &params);
+   if (ring_fd < 0) {
+      return false;
+   }
+
+   ring->ring_fd = ring_fd;
+   ring->entries = params.sq_entries;
+   ring->sq_ring_size = params.sq_off.array + params.sq_entries * sizeof(uint32_t);
+   ring->cq_ring_size = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+   bool single_mmap = params.features & IORING_FEAT_SINGLE_MMAP;
+   if (single_mmap && ring->cq_ring_size > ring->sq_ring_size) {
+      ring->sq_ring_size = ring->cq_ring_size;
+   }
+
+   ring->sq_ring = mmap(NULL, ring->sq_ring_size, PROT_READ | PROT_WRITE,
+                        MAP_SHARED | MAP_POPULATE, ring_fd, IORING_OFF_SQ_RING);
+   if (ring->sq_ring == MAP_FAILED) {
+      close(ring_fd);
+      return false;
+   }
+   if (single_mmap) {
+      ring->cq_ring = ring->sq_ring;
+   } else {
+      ring->cq_ring = mmap(NULL, ring->cq_ring_size, PROT_READ | PROT_WRITE,
+                           MAP_SHARED | MAP_POPULATE, ring_fd, IORING_OFF_CQ_RING);
+      if (ring->cq_ring == MAP_FAILED) {
+         munmap(ring->sq_ring, ring->sq_ring_size);
+         close(ring_fd);
+         return false;
+      }
+   }
+   ring->sqes_size = params.sq_entries * sizeof(struct io_uring_sqe);
+   ring->sqes = mmap(NULL, ring->sqes_size, PROT_READ | PROT_WRITE,
+                     MAP_SHARED | MAP_POPULATE, ring_fd, IORING_OFF_SQES);
+   if (ring->sqes == MAP_FAILED) {
+      if (!single_mmap) {
+         munmap(ring->cq_ring, ring->cq_ring_size);
+      }
+      munmap(ring->sq_ring, ring->sq_ring_size);
+      close(ring_fd);
+      return false;
+   }
+
+   ring->sq_tail = ring->sq_ring + params.sq_off.tail;
+   ring->sq_mask = ring->sq_ring + params.sq_off.ring_mask;
+   ring->sq_array = ring->sq_ring + params.sq_off.array;
+   ring->cq_head = ring->cq_ring + params.cq_off.head;
+   ring->cq_tail = ring->cq_ring + params.cq_off.tail;
+   ring->cq_mask = ring->cq_ring + params.cq_off.ring_mask;
+   ring->cqes = ring->cq_ring + params.cq_off.cqes;
+   return true;
+}
+
+void io_uring_destroy(IoUring* ring) {
+   munmap(ring->sqes, ring->sqes_size);
+   if (ring->cq_ring != ring->sq_ring) {
+      munmap(ring->cq_ring, ring->cq_ring_size);
+   }
+   munmap(ring->sq_ring, ring->sq_ring_size);
+   close(ring->ring_fd);
+}
+
+/*
+   每次最多放 entries 个请求进提交队列，一次 io_uring_enter 提交并等它们全部完成。
+   失败或短读写的请求改用同步方式补完，补不完的返回第一个 errno
+*/
+int io_uring_batch(IoContext* io, IoOperation operation, IoRequest* requests, uint32_t count) {
+   IoUring* ring = &io->ring;
+   uint32_t submitted = 0;
+   int first_error = 0;
+   while (submitted < count) {
+      uint32_t chunk = count - submitted;
+      if (chunk > ring->entries) {
+         chunk = ring->entries;
+      }
+
+      uint32_t tail = *ring->sq_tail;
+      for (uint32_t i = 0; i < chunk; i++) {
+         IoRequest* request = &requests[submitted + i];
+         uint32_t index = (tail + i) & *ring->sq_mask;
+         struct io_uring_sqe* sqe = &ring->sqes[index];
+         memset(sqe, 0, sizeof(*sqe));
+         sqe->opcode = operation == IO_READ ? IORING_OP_READ : IORING_OP_WRITE;
+         sqe->fd = io->fd;
+         sqe->addr = (uint64_t)(uintptr_t)request->buffer;
+         sqe->len = request->length;
+         sqe->off = request->offset;
+         sqe->user_data = submitted + i;
+         ring->sq_array[index] = index;
+      }
+      __atomic_store_n(ring->sq_tail, tail + chunk, __ATOMIC_RELEASE);
+
+      uint32_t completed = 0;
+      uint32_t to_submit = chunk;
+      while (completed < chunk) {
+         int entered = syscall(__NR_io_uring_enter, ring->ring_fd, to_submit, chunk - completed,
+                               IORING_ENTER_GETEVENTS, NULL, 0);
+         STAT_INC(operation == IO_READ ? STAT_READ_SYSCALL : STAT_WRITE_SYSCALL);
+         if (entered < 0) {
+            if (errno == EINTR) {
+               continue;
+            }
+            //环的状态不再可信，之后都用同步读写。环里可能还有没完成的请求，留到 io_close 再拆
+            io->backend = DB_IO_SYNC;
+            return errno;
+         }
+         to_submit -= entered;
+
+         uint32_t head = *ring->cq_head;
+         uint32_t cq_tail = __atomic_load_n(ring->cq_tail, __ATOMIC_ACQUIRE);
+         while (head != cq_tail) {
+            struct io_uring_cqe* cqe = &ring->cqes[head & *ring->cq_mask];
+            IoRequest* request = &requests[cqe->user_data];
+            int32_t result = cqe->res;
+            head++;
+            completed++;
+
+            int error = 0;
+            if (result < 0) {
+               error = io_transfer(io->fd, operation, request, 0);
+            } else if ((uint32_t)result < request->length) {
+               error = io_transfer(io->fd, operation, request, result);
+            }
+            if (error != 0 && first_error == 0) {
+               first_error = error;
+            }
+         }
+         __atomic_store_n(ring->cq_head, head, __ATOMIC_RELEASE);
+      }
+      submitted += chunk;
+   }
+   return first_error;
+}
+
+void* io_thread_main(void* argument) {
+   IoContext* io = argument;
+   IoThreadPool* pool = &io->pool;
+
+   pthread_mutex_lock(&pool->lock);
+   while (true) {
+      while (!pool->shutdown && pool->next == pool->batch_count) {
+         pthread_cond_wait(&pool->work_ready, &pool->lock);
+      }
+      if (pool->shutdown) {
+         break;
+      }
+      IoRequest* request = &pool->batch[pool->next++];
+      IoOperation operation = pool->operation;
+      pthread_mutex_unlock(&pool->lock);
+
+      int error = io_transfer(io->fd, operation, request, 0);
+
+      pthread_mutex_lock(&pool->lock);
+      if (error != 0 && pool->error == 0) {
+         pool->error = error;
+      }
+      pool->completed++;
+      if (pool->completed == pool->batch_count) {
+         pthread_cond_signal(&pool->work_done);
+      }
+   }
+   pthread_mutex_unlock(&pool->lock);
+   return NULL;
+}
+
+bool io_thread_pool_init(IoContext* io) {
+   IoThreadPool* pool = &io->pool;
+   pthread_mutex_init(&pool->lock, NULL);
+   pthread_cond_init(&pool->work_ready, NULL);
+   pthread_cond_init(&pool->work_done, NULL);
+   pool->batch = NULL;
+   pool->batch_count = 0;
+   pool->next = 0;
+   pool->completed = 0;
+   pool->error = 0;
+   pool->shutdown = false;
+
+   for (uint32_t i = 0; i < IO_THREAD_COUNT; i++) {
+      if (pthread_create(&pool->threads[i], NULL, io_thread_main, io) != 0) {
+         //已经起来的线程收回，调用者退回同步读写
+         pthread_mutex_lock(&pool->lock);
+         pool->shutdown = true;
+         pthread_cond_broadcast(&pool->work_ready);
+         pthread_mutex_unlock(&pool->lock);
+         for (uint32_t j = 0; j < i; j++) {
+            pthread_join(pool->threads[j], NULL);
+         }
+         pthread_mutex_destroy(&pool->lock);
+         pthread_cond_destroy(&pool->work_ready);
+         pthread_cond_destroy(&pool->work_done);
+         return false;
+      }
+   }
+   return true;
+}
+
+int io_thread_pool_batch(IoContext* io, IoOperation operation, IoRequest* requests, uint32_t count) {
+   IoThreadPool* pool = &io->pool;
+   pthread_mutex_lock(&pool->lock);
+   pool->batch = requests;
+   pool->operation = operation;
+   pool->batch_count = count;
+   pool->next = 0;
+   pool->completed = 0;
+   pool->error = 0;
+   pthread_cond_broadcast(&pool->work_ready);
+   while (pool->completed < count) {
+      pthread_cond_wait(&pool->work_done, &pool->lock);
+   }
+   int error = pool->error;
+   pool->batch = NULL;
+   pool->batch_count = 0;
+   pool->next = 0;
+   pthread_mutex_unlock(&pool->lock);
+   return error;
+}
+
+void io_thread_pool_destroy(IoContext* io) {
+   IoThreadPool* pool = &io->pool;
+   pthread_mutex_lock(&pool->lock);
+   pool->shutdown = true;
+   pthread_cond_broadcast(&pool->work_ready);
+   pthread_mutex_unlock(&pool->lock);
+   for (uint32_t i = 0; i < IO_THREAD_COUNT; i++) {
+      pthread_join(pool->threads[i], NULL);
+   }
+   pthread_mutex_destroy(&pool->lock);
+   pthread_cond_destroy(&pool->work_ready);
+   pthread_cond_destroy(&pool->work_done);
+}
+
+IoContext* io_open(int fd, DbIoBackend backend) {
+   IoContext* io = malloc(sizeof(IoContext));
+   io->fd = fd;
+   io->backend = backend;
+   io->ring_open = false;
+
+   if (backend == DB_IO_URING) {
+      io->ring_open = io_uring_init(&io->ring);
+      if (!io->ring_open) {
+         io->backend = DB_IO_THREADS;
+      }
+   }
+   if (io->backend == DB_IO_THREADS && !io_thread_pool_init(io)) {
+      io->backend = DB_IO_SYNC;
+   }
+   return io;
+}
+
+DbIoBackend io_backend(IoContext* io) {
+   return io->backend;
+}
+
+int io_batch(IoContext* io, IoOperation operation, IoRequest* requests, uint32_t count) {
+   if (count == 0) {
+      return 0;
+   }
+   STAT_ADD(operation == IO_READ ? STAT_PAGES_READ : STAT_PAGES_WRITTEN, count);
+
+   //只有一个请求时交给线程没有好处，直接同步读写
+   if (io->backend == DB_IO_THREADS && count > 1) {
+      return io_thread_pool_batch(io, operation, requests, count);
+   }
+   int first_error = 0;
+   switch (io->backend) {
+      case (DB_IO_URING):
+         first_error = io_uring_batch(io, operation, requests, count);
+         break;
+      case (DB_IO_THREADS):
+      case (DB_IO_SYNC):
+      default:
+         for (uint32_t i = 0; i < count; i++) {
+            int error = io_transfer(io->fd, operation, &requests[i], 0);
+            if (error != 0 && first_error == 0) {
+               first_error = error;
+            }
+         }
+         break;
+   }
+   return first_error;
+}
+
+/*
+   先用 copy_file_range 在内核里拷贝，数据不经过用户态；
+   跨文件系统、O_DIRECT 之类不支持的情况退回大块 pread/pwrite
+*/
+int io_copy_range(int source, int destination, uint64_t offset, uint64_t length) {
+   uint64_t done = 0;
+   while (done < length) {
+      loff_t source_offset = offset + done;
+      loff_t destination_offset = offset + done;
+      ssize_t bytes = copy_file_range(source, &source_offset, destination, &destination_offset,
+                                      length - done, 0);
+      STAT_INC(STAT_WRITE_SYSCALL);
+      if (bytes == -1) {
+         if (errno == EINTR) {
+            continue;
+         }
+         if (errno == EINVAL || errno == EXDEV || errno == ENOSYS || errno == EOPNOTSUPP) {
+            break;
+         }
+         return errno;
+      }
+      if (bytes == 0) {
+         return EIO; //源文件比要拷贝的范围短
+      }
+      done += bytes;
+   }
+   if (done == length) {
+      return 0;
+   }
+
+   void* buffer = io_alloc_buffer(IO_COPY_BUFFER_SIZE);
+   int error = 0;
+   while (done < length && error == 0) {
+      uint32_t chunk = length - done < IO_COPY_BUFFER_SIZE ? (uint32_t)(length - done) : IO_COPY_BUFFER_SIZE;
+      IoRequest request = {buffer, offset + done, chunk};
+      error = io_transfer(source, IO_READ, &request, 0);
+      if (error == 0) {
+         error = io_transfer(destination, IO_WRITE, &request, 0);
+      }
+      done += chunk;
+   }
+   free(buffer);
+   return error;
+}
+
+int io_read(IoContext* io, IoRequest* requests, uint32_t count) {
+   return io_batch(io, IO_READ, requests, count);
+}
+
+int io_write(IoContext* io, IoRequest* requests, uint32_t count) {
+   return io_batch(io, IO_WRITE, requests, count);
+}
+
+void io_close(IoContext* io) {
+   if (io->ring_open) {
+      io_uring_destroy(&io->ring); //按 ring_open 而不是 backend，出错退回同步后也要拆
+   }
+   if (io->backend == DB_IO_THREADS) {
+      io_thread_pool_destroy(io);
+   }
+   free(io);
+}
@@ -0,0 +1,47 @@
+#ifndef MYDB_IO_H
+#define MYDB_IO_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "mydb.h"
+
+/*
+   pager 的磁盘读写后端。请求按批提交，函数返回时整批都已完成：
+      DB_IO_SYNC     每页一次 pread/pwrite
+      DB_IO_URING    一批请求放进 io_uring，一次 io_uring_enter 提交并等待
+      DB_IO_THREADS  线程池并发 pread/pwrite，io_uring 不可用时的后备
+*/
+
+typedef struct {
+   void* buffer;
+   uint64_t offset;
+   uint32_t length;
+} IoRequest;
+
+typedef struct IoContext IoContext;
+
+//direct 为 true 时尝试 O_DIRECT，文件系统不支持时退回普通打开，*direct_enabled 报告实际结果
+int io_open_file(const char* filename, bool direct, bool* direct_enabled);
+//按 IO_BUFFER_ALIGNMENT 对齐的缓冲区，O_DIRECT 要求
+#define IO_BUFFER_ALIGNMENT 4096
+void* io_alloc_buffer(uint32_t size);
+
+//请求 DB_IO_URING 但内核不支持时返回线程池后端，线程起不来时退回同步读写
+IoContext* io_open(int fd, DbIoBackend backend);
+DbIoBackend io_backend(IoContext* io);
+const char* io_backend_name(DbIoBackend backend);
+//读到文件末尾之后的部分填0。整批都做完才返回，返回0成功，否则返回第一个失败请求的 errno
+int io_read(IoContext* io, IoRequest* requests, uint32_t count);
+int io_write(IoContext* io, IoRequest* requests, uint32_t count);
+//不关闭文件
+void io_close(IoContext* io);
+
+/*
+   把 source 的 [offset, offset+length) 拷贝到 destination 的同一位置，不经过 IoContext，
+   可以在别的线程里调用。返回0成功，否则返回 errno
+*/
+#define IO_COPY_BUFFER_SIZE (1024 * 1024)
+int io_copy_range(int source, int destination, uint64_t offset, uint64_t length);
+
+#endif
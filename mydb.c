@@ -0,0 +1,2473 @@
+#define _POSIX_C_SOURCE 200809L //ftruncate
+
+#define _FILE_OFFSET_BITS 64 //32位平台上 off_t 也是64位
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "arena.h"
+#include "io.h"
+#include "mydb.h"
+#include "schema.h"
+#include "stats.h"
+
+#define TABLE_NAME_SIZE COLUMN_NAME_SIZE
+#define size_of_attribute(Struct, Attribute) sizeof(((Struct*)0)->Attribute)
+
+typedef struct Backup Backup;
+
+typedef struct
+{
+   int file_descriptor;
+   IoContext* io;
+   PageArena* arena;          //页帧从这里分配，页大小确定后创建
+   bool huge_pages;
+   bool direct_io;            //实际是否用上了 O_DIRECT
+   uint32_t page_size;        //打开db时由文件头决定
+   uint32_t page_size_shift;  //page_size = 1 << page_size_shift
+   uint64_t file_length;
+   uint64_t num_pages;
+   uint64_t pages_capacity;
+   void** pages;  //按页号索引的页缓存，不够时扩容
+   uint8_t* dirty; //和 pages 对应，修改过的页关闭时写回
+   void* scratch;  //重新编码叶节点时存放原节点的副本，第一次用时分配
+   Backup* backup; //正在进行的在线备份，没有时为 NULL
+   DbResult error;   //第一次读页出错或发现页号越界后，不再往文件里写
+   void* error_page; //出错时代替真实页返回的空叶节点
+} Pager;  //页面管理
+
+/*
+   节点布局。key 和页号的宽度取决于文件格式版本(见 node_layout_init)，
+   其余偏移都由这两个宽度算出来，打开db时计算一次
+
+   叶节点：  [通用头部][num_cells][next_leaf] [key][value] [key][value] ...
+   内部节点：[通用头部][num_keys][right_child] [child][key] [child][key] ...
+
+   版本5起叶节点的 key 单独成一个连续数组，按 key_base 加差值存(frame-of-reference)，
+   差值宽度 key_width 是放得下节点里最大差值的最窄宽度(2/4/8字节)，value 数组紧跟在后面：
+   叶节点：  [通用头部][num_cells][next_leaf][key_base][key_width] [差值][差值]... [value][value]...
+   差值数组按这个宽度下的最大cell数留位置，宽度变了整个节点重新编码
+*/
+typedef struct {
+   uint32_t key_size;
+   uint32_t page_num_size;   //父指针、next指针和孩子指针
+   uint32_t common_node_header_size;
+   uint32_t leaf_node_num_cells_offset;
+   uint32_t leaf_node_next_leaf_offset;
+   bool packed_keys;         //版本5起
+   bool signed_keys;         //版本6起，见 table_key
+   uint32_t leaf_node_key_base_offset;
+   uint32_t leaf_node_key_width_offset;
+   uint32_t leaf_node_header_size;
+   uint32_t leaf_node_space_for_cells;
+   uint32_t internal_node_num_keys_offset;
+   uint32_t internal_node_right_child_offset;
+   uint32_t internal_node_header_size;
+   uint32_t internal_node_cell_size;
+   uint32_t internal_node_max_cells;
+} NodeLayout;
+
+typedef struct Table Table;
+
+/*
+   点查询缓存的一项：key 上次在哪个叶节点的哪个 cell。
+   插入和分裂会移动 cell，这里不跟着改，而是查的时候核对那个位置上的 key，
+   对不上就当未命中，重新从根查找后覆盖
+*/
+typedef struct {
+   uint64_t key;
+   uint64_t page_num;
+   uint32_t cell_num;
+   bool valid;
+} LookupCacheEntry;
+
+/*
+   树的形状，.stats 用。插入和分裂时增量维护，不用每次遍历整棵树
+*/
+typedef struct {
+   uint32_t height;
+   uint64_t internal_nodes;
+   uint64_t leaf_nodes;
+   uint64_t rows;
+   bool rows_known; //从文件打开的表要等所有叶节点都在缓存里数过一遍才知道行数，见 tree_shape_load
+} TreeShape;
+
+struct Table {
+   Database* db;
+   Pager* pager;            //同一个文件里的表共享 db 的 pager
+   const NodeLayout* layout; //同上，指向 db->layout
+   uint32_t table_id;
+   char name[TABLE_NAME_SIZE];
+   uint64_t root_page_num;
+   Schema schema;
+   /*
+      叶节点布局取决于行大小，打开表时根据schema计算
+   */
+   uint32_t leaf_node_cell_size;
+   uint32_t leaf_node_max_cells;   //版本5起是差值宽度为8字节时的cell数，也就是最少的情况
+   uint32_t leaf_node_packed_max_cells[3]; //版本5起按差值宽度 2/4/8 字节，下标是 key_width >> 2
+   uint32_t leaf_node_left_split_count;
+   uint32_t leaf_node_right_split_count;
+   LookupCacheEntry* lookup_cache; //第一次点查询时分配，db->lookup_cache_size 为0时不用
+   TreeShape shape;
+   bool shape_loaded;  //新建的表一开始就是准的，从文件打开的表第一次 .stats 时才统计
+}; //表结构
+
+struct Database {
+   Pager* pager;
+   uint32_t format_version; //0 表示没有文件头的旧格式
+   NodeLayout layout;
+   Table* catalog;          //系统表，旧格式没有
+   uint32_t num_tables;
+   uint32_t tables_capacity;
+   Table** tables;
+   Statement* free_statements; //db_finalize 回收的语句，db_prepare 优先复用
+   uint32_t lookup_cache_size; //每张表点查询缓存的项数，2的幂
+}; //一个db文件
+
+typedef enum {
+   STATEMENT_INSERT,
+   STATEMENT_SELECT,
+   STATEMENT_CREATE
+} StatementType;
+
+typedef enum {
+   NODE_INTERNAL,
+   NODE_LEAF
+} NodeType;
+
+typedef struct {
+   Table* table;
+   uint64_t page_num;
+   uint32_t cell_num;
+   bool end_of_table;
+} Cursor;
+
+struct Statement {
+   StatementType type;
+   uint8_t row[ROW_MAX_SIZE]; //insert 时是要插入的行，select 时是当前行
+   SchemaDescriptor schema_to_create;
+   char table_name[TABLE_NAME_SIZE]; //create table 的表名
+   Database* db;
+   Table* table;
+   Cursor cursor;       //select 的扫描位置，第一次 db_step 时定位
+   bool cursor_open;
+   bool point_lookup;   //select ... where <主键列> = <值>
+   uint64_t lookup_key;
+   Statement* next_free;
+}; //包含要操作的行和操作类型
+
+/*
+   文件头，位于page 0。
+   版本0：没有文件头，page 0 直接是唯一一张表的根节点，schema 是原来写死的 Row
+   版本1：文件头里记录唯一一张表的根页号和schema，打开时升级到版本2
+   版本2：文件头里记录系统表(catalog)的根页号，所有表都登记在系统表里
+   版本3：key、页号和系统表里的根页号都改成64位，主键可以是 bigint
+   版本4：文件头里记录页大小，新建文件时选定(4KB~64KB)
+   版本5：叶节点的 key 按基准值+差值压缩存放(见 NodeLayout)
+   版本6：主键翻转符号位后再存，负主键也按有符号顺序排列(见 table_key)
+   版本0~2 的文件保持32位布局打开，不做转换；版本4之前的文件页大小都是4KB；
+   版本3、4 的文件叶节点保持不压缩；版本6之前的文件 key 按原样存，不能插入负主键；
+   新建的文件都是版本6
+*/
+#define FILE_HEADER_MAGIC "mydbfile"
+#define FILE_HEADER_MAGIC_SIZE 8
+const uint32_t FILE_FORMAT_VERSION = 6;
+const uint32_t FILE_FORMAT_VERSION_CATALOG = 2;    //有系统表的最低版本
+const uint32_t FILE_FORMAT_VERSION_WIDE = 3;       //64位布局的最低版本
+const uint32_t FILE_FORMAT_VERSION_PAGE_SIZE = 4;  //文件头有页大小的最低版本
+const uint32_t FILE_FORMAT_VERSION_PACKED_KEYS = 5; //叶节点 key 压缩的最低版本
+const uint32_t FILE_FORMAT_VERSION_SIGNED_KEYS = 6; //负主键按有符号顺序排列的最低版本
+const uint32_t LEGACY_PAGE_SIZE = 4096;
+
+typedef struct {
+   char magic[FILE_HEADER_MAGIC_SIZE];
+   uint32_t format_version;
+   uint32_t root_page_num;          //仅版本1
+   SchemaDescriptor schema;         //仅版本1
+   uint32_t catalog_root_page_num;  //版本2
+   uint64_t catalog_root_page;      //版本3起
+   uint32_t page_size;              //版本4起
+} FileHeader;
+
+/*
+   系统表本身也是一棵B+树，按 table_id 排序，每行登记一张表：
+   (table_id int, name char(32), root_page int, schema char(sizeof(SchemaDescriptor)))
+   表很少，打开db时把整棵树读进内存，按名字查找不走B+树。
+   版本3起 root_page 列是 bigint
+*/
+typedef enum {
+   CATALOG_COLUMN_TABLE_ID,
+   CATALOG_COLUMN_NAME,
+   CATALOG_COLUMN_ROOT_PAGE,
+   CATALOG_COLUMN_SCHEMA
+} CatalogColumn;
+
+#define DEFAULT_TABLE_NAME "main" //旧文件里唯一的那张表，也是不写表名时操作的表
+
+
+
+/*
+   普通节点头部元数据，父节点页号的宽度见 NodeLayout
+*/
+const uint32_t NODE_TYPE_SIZE = sizeof(uint8_t);
+const uint32_t NODE_TYPE_OFFSET = 0;
+const uint32_t IS_ROOT_SIZE = sizeof(uint8_t);
+#define IS_ROOT_OFFSET  NODE_TYPE_SIZE
+#define PARENT_POINTER_OFFSET  (IS_ROOT_OFFSET + IS_ROOT_SIZE)
+/*
+   叶节点Header信息,每个CELLS是一个键值对。
+   CELLS的value是一个serialized row，大小由表的schema决定，cell大小和每页cell数见 Table
+*/
+const uint32_t LEAF_NODE_NUM_CELLS_SIZE = sizeof(uint32_t);
+const uint32_t LEAF_NODE_KEY_BASE_SIZE = sizeof(uint64_t);
+const uint32_t LEAF_NODE_KEY_WIDTH_SIZE = sizeof(uint8_t);
+const uint32_t LEAF_NODE_MIN_KEY_WIDTH = sizeof(uint16_t);
+/*
+   内部节点Header信息
+*/
+const uint32_t INTERNAL_NODE_NUM_KEYS_SIZE = sizeof(uint32_t);
+
+/*
+   版本0~2 是32位key和页号，版本3起是64位；各区域大小随页大小变化
+*/
+void node_layout_init(NodeLayout* layout, uint32_t format_version, uint32_t page_size) {
+   uint32_t width = format_version >= FILE_FORMAT_VERSION_WIDE ? sizeof(uint64_t) : sizeof(uint32_t);
+   layout->key_size = width;
+   layout->page_num_size = width;
+   layout->common_node_header_size = NODE_TYPE_SIZE + IS_ROOT_SIZE + layout->page_num_size;
+
+   layout->leaf_node_num_cells_offset = layout->common_node_header_size;
+   layout->leaf_node_next_leaf_offset = layout->leaf_node_num_cells_offset + LEAF_NODE_NUM_CELLS_SIZE;
+   layout->packed_keys = format_version >= FILE_FORMAT_VERSION_PACKED_KEYS;
+   layout->signed_keys = format_version >= FILE_FORMAT_VERSION_SIGNED_KEYS;
+   layout->leaf_node_key_base_offset = layout->leaf_node_next_leaf_offset + layout->page_num_size;
+   layout->leaf_node_key_width_offset = layout->leaf_node_key_base_offset + LEAF_NODE_KEY_BASE_SIZE;
+   if (layout->packed_keys) {
+      //差值数组按8字节对齐
+      layout->leaf_node_header_size = (layout->leaf_node_key_width_offset + LEAF_NODE_KEY_WIDTH_SIZE + 7) & ~7u;
+   } else {
+      layout->leaf_node_header_size = layout->leaf_node_key_base_offset;
+   }
+   layout->leaf_node_space_for_cells = page_size - layout->leaf_node_header_size;
+
+   layout->internal_node_num_keys_offset = layout->common_node_header_size;
+   layout->internal_node_right_child_offset = layout->internal_node_num_keys_offset + INTERNAL_NODE_NUM_KEYS_SIZE;
+   layout->internal_node_header_size = layout->internal_node_right_child_offset + layout->page_num_size;
+   layout->internal_node_cell_size = layout->page_num_size + layout->key_size;
+   layout->internal_node_max_cells =
+         (page_size - layout->internal_node_header_size) / layout->internal_node_cell_size;
+}
+
+void set_node_type(void* node, NodeType type);
+void leaf_node_insert(Cursor* cursor, uint64_t key, uint8_t* value);
+void internal_node_split_and_insert(Table* table, uint64_t parent_page_num, uint64_t child_page_num);
+void create_new_root(Table* table, uint64_t right_child_page_num);
+uint64_t get_unused_page_num(Pager* pager);
+void table_find(Table* table, uint64_t key, Cursor* cursor);
+void table_start(Table* table, Cursor* cursor);
+void* cursor_value(Cursor* cursor);
+void cursor_advance(Cursor* cursor);
+void print_tree(Table* table, uint64_t page_num, uint32_t indentation_level);
+
+/*
+   节点里的 key 和页号按布局的宽度存取，叶节点的 key 差值还可能是2字节
+*/
+uint64_t node_read(const void* field, uint32_t size) {
+   if (size == sizeof(uint64_t)) {
+      uint64_t value;
+      memcpy(&value, field, sizeof(value));
+      return value;
+   }
+   if (size == sizeof(uint16_t)) {
+      uint16_t value;
+      memcpy(&value, field, sizeof(value));
+      return value;
+   }
+   uint32_t value;
+   memcpy(&value, field, sizeof(value));
+   return value;
+}
+
+void node_write(void* field, uint32_t size, uint64_t value) {
+   if (size == sizeof(uint64_t)) {
+      memcpy(field, &value, sizeof(value));
+   } else if (size == sizeof(uint16_t)) {
+      uint16_t narrow = (uint16_t)value;
+      memcpy(field, &narrow, sizeof(narrow));
+   } else {
+      uint32_t narrow = (uint32_t)value;
+      memcpy(field, &narrow, sizeof(narrow));
+   }
+}
+
+/*
+   访问这个叶节点有多少个cells
+*/
+uint32_t* leaf_node_num_cells(Table* table, void* node) {
+   return node + table->layout->leaf_node_num_cells_offset;
+}
+/*
+   访问这个叶节点的某一个指定的cell，仅用于 key 不压缩的叶节点
+*/
+void* leaf_node_cell(Table* table, void* node, uint32_t cell_num) {
+   return node + table->layout->leaf_node_header_size + cell_num * table->leaf_node_cell_size;
+}
+
+/*
+   压缩的叶节点(版本5起)：key = key_base + 差值
+*/
+uint64_t leaf_node_key_base(Table* table, void* node) {
+   return node_read(node + table->layout->leaf_node_key_base_offset, LEAF_NODE_KEY_BASE_SIZE);
+}
+
+void set_leaf_node_key_base(Table* table, void* node, uint64_t key) {
+   node_write(node + table->layout->leaf_node_key_base_offset, LEAF_NODE_KEY_BASE_SIZE, key);
+}
+
+uint32_t leaf_node_key_width(Table* table, void* node) {
+   return *(uint8_t*)(node + table->layout->leaf_node_key_width_offset);
+}
+
+void set_leaf_node_key_width(Table* table, void* node, uint32_t width) {
+   *(uint8_t*)(node + table->layout->leaf_node_key_width_offset) = (uint8_t)width;
+}
+
+void* leaf_node_key_deltas(Table* table, void* node) {
+   return node + table->layout->leaf_node_header_size;
+}
+
+//放得下差值 range 的最窄宽度
+uint32_t leaf_key_width_for(uint64_t range) {
+   if (range <= UINT16_MAX) {
+      return sizeof(uint16_t);
+   }
+   if (range <= UINT32_MAX) {
+      return sizeof(uint32_t);
+   }
+   return sizeof(uint64_t);
+}
+
+//这个叶节点最多放几个cell，压缩的叶节点随差值宽度变化
+uint32_t leaf_node_capacity(Table* table, void* node) {
+   if (!table->layout->packed_keys) {
+      return table->leaf_node_max_cells;
+   }
+   return table->leaf_node_packed_max_cells[leaf_node_key_width(table, node) >> 2];
+}
+/*
+   访问这个叶节点的某一个指定的cell的key
+*/
+uint64_t leaf_node_key(Table* table, void* node, uint32_t cell_num) {
+   if (table->layout->packed_keys) {
+      uint32_t width = leaf_node_key_width(table, node);
+      return leaf_node_key_base(table, node) + node_read(leaf_node_key_deltas(table, node) + cell_num * width, width);
+   }
+   return node_read(leaf_node_cell(table, node, cell_num), table->layout->key_size);
+}
+
+//仅用于 key 不压缩的叶节点，压缩的叶节点见 leaf_node_pack
+void set_leaf_node_key(Table* table, void* node, uint32_t cell_num, uint64_t key) {
+   node_write(leaf_node_cell(table, node, cell_num), table->layout->key_size, key);
+}
+/*
+   访问这个叶节点的某一个指定的cell的value
+*/
+void* leaf_node_value(Table* table, void* node,uint32_t cell_num) {
+   if (table->layout->packed_keys) {
+      uint32_t width = leaf_node_key_width(table, node);
+      return leaf_node_key_deltas(table, node) + leaf_node_capacity(table, node) * width +
+             cell_num * table->schema.row_size;
+   }
+   return leaf_node_cell(table, node, cell_num) + table->layout->key_size;
+}
+/*
+   访问这个叶节点的next指针
+*/
+uint64_t leaf_node_next_leaf(Table* table, void* node) {
+   return node_read(node + table->layout->leaf_node_next_leaf_offset, table->layout->page_num_size);
+}
+
+void set_leaf_node_next_leaf(Table* table, void* node, uint64_t page_num) {
+   node_write(node + table->layout->leaf_node_next_leaf_offset, table->layout->page_num_size, page_num);
+}
+
+bool is_node_root(void* node) {
+   uint8_t value = *((uint8_t*)(node + IS_ROOT_OFFSET));
+   return (bool)value;
+}
+
+void set_node_root(void* node, bool is_root) {
+   uint8_t value = is_root;
+   *((uint8_t*)(node + IS_ROOT_OFFSET)) = value;
+}
+/*
+   初始化叶节点
+*/
+void initialize_leaf_node(Table* table, void* node) {
+   set_node_type(node, NODE_LEAF);
+   set_node_root(node, false);
+   *leaf_node_num_cells(table, node) = 0;
+   set_leaf_node_next_leaf(table, node, 0);
+   if (table->layout->packed_keys) {
+      set_leaf_node_key_base(table, node, 0);
+      set_leaf_node_key_width(table, node, LEAF_NODE_MIN_KEY_WIDTH);
+   }
+}
+
+uint32_t* internal_node_num_keys(Table* table, void* node) {
+   return node + table->layout->internal_node_num_keys_offset;
+}
+
+/*
+   初始化内部节点
+*/
+void initialize_internal_node(Table* table, void* node) {
+   set_node_type(node, NODE_INTERNAL);
+   set_node_root(node, false);
+   *internal_node_num_keys(table, node) = 0;
+}
+
+uint64_t internal_node_right_child(Table* table, void* node) {
+   return node_read(node + table->layout->internal_node_right_child_offset, table->layout->page_num_size);
+}
+
+void set_internal_node_right_child(Table* table, void* node, uint64_t page_num) {
+   node_write(node + table->layout->internal_node_right_child_offset, table->layout->page_num_size, page_num);
+}
+
+void* internal_node_cell(Table* table, void* node, uint32_t cell_num) {
+   return node + table->layout->internal_node_header_size + cell_num * table->layout->internal_node_cell_size;
+}
+
+//第 child_num 个孩子指针的位置，child_num == num_keys 时是右孩子
+void* internal_node_child_field(Table* table, void* node, uint32_t child_num) {
+   uint32_t num_keys = *internal_node_num_keys(table, node);
+   if (child_num > num_keys) {
+      printf("尝试访问child_num %d > num_keys %d\n", child_num, num_keys);
+      exit(EXIT_FAILURE);
+   } else if (child_num == num_keys) {
+      return node + table->layout->internal_node_right_child_offset;
+   } else {
+      return internal_node_cell(table, node, child_num);
+   }
+}
+
+uint64_t internal_node_child(Table* table, void* node, uint32_t child_num) {
+   return node_read(internal_node_child_field(table, node, child_num), table->layout->page_num_size);
+}
+
+void set_internal_node_child(Table* table, void* node, uint32_t child_num, uint64_t page_num) {
+   node_write(internal_node_child_field(table, node, child_num), table->layout->page_num_size, page_num);
+}
+
+uint64_t internal_node_key(Table* table, void* node, uint32_t key_num) {
+   return node_read(internal_node_cell(table, node, key_num) + table->layout->page_num_size,
+                    table->layout->key_size);
+}
+
+void set_internal_node_key(Table* table, void* node, uint32_t key_num, uint64_t key) {
+   node_write(internal_node_cell(table, node, key_num) + table->layout->page_num_size,
+              table->layout->key_size, key);
+}
+
+/*
+   引擎里的堆分配都走这里，计入 heap_allocations，
+   用来确认执行语句的热路径上没有 malloc
+*/
+void* heap_alloc(size_t size) {
+   STAT_INC(STAT_HEAP_ALLOCATIONS);
+   void* memory = malloc(size);
+   if (memory == NULL) {
+      printf("Error allocating memory\n");
+      exit(EXIT_FAILURE);
+   }
+   return memory;
+}
+
+void* heap_realloc(void* memory, size_t size) {
+   STAT_INC(STAT_HEAP_ALLOCATIONS);
+   memory = realloc(memory, size);
+   if (memory == NULL) {
+      printf("Error allocating memory\n");
+      exit(EXIT_FAILURE);
+   }
+   return memory;
+}
+
+//打不开文件时返回 NULL
+Pager* pager_open(const char* filename, const DatabaseOptions* options) {
+   bool direct_io;
+   int fd = io_open_file(filename, options->direct_io, &direct_io);
+   if (fd == -1) {
+      return NULL;
+   }
+
+   off_t file_length = lseek(fd, 0, SEEK_END); //移到文件末尾，返回文件偏移量
+
+   Pager* pager = heap_alloc(sizeof(Pager));
+   pager->file_descriptor = fd;
+   pager->io = io_open(fd, options->io_backend);
+   pager->arena = NULL;
+   pager->huge_pages = options->huge_pages;
+   pager->direct_io = direct_io;
+   pager->file_length = file_length;
+   pager->page_size = 0;
+   pager->page_size_shift = 0;
+   pager->num_pages = 0;
+   pager->pages_capacity = 0;
+   pager->pages = NULL;
+   pager->dirty = NULL;
+   pager->scratch = NULL;
+   pager->backup = NULL;
+   pager->error = DB_OK;
+   pager->error_page = NULL;
+
+   return pager;
+}
+
+bool page_size_valid(uint32_t page_size) {
+   return page_size >= DB_MIN_PAGE_SIZE && page_size <= DB_MAX_PAGE_SIZE &&
+          (page_size & (page_size - 1)) == 0;
+}
+
+/*
+   页大小要先从文件头读出来才能确定，所以 pager_open 之后再设置。
+   页大小是2的幂，页号和文件偏移之间用移位换算
+*/
+DbResult pager_set_page_size(Pager* pager, uint32_t page_size) {
+   if ((pager->file_length & (page_size - 1)) != 0) {
+      return DB_ERROR_CORRUPT; //db 文件大小不是页大小的整数倍
+   }
+   pager->page_size = page_size;
+   pager->page_size_shift = 0;
+   while ((1u << pager->page_size_shift) < page_size) {
+      pager->page_size_shift++;
+   }
+   pager->num_pages = pager->file_length >> pager->page_size_shift;
+   pager->arena = arena_open(page_size, pager->huge_pages);
+   return DB_OK;
+}
+
+/*
+   页缓存按页号索引，容量不够时翻倍
+*/
+void pager_reserve(Pager* pager, uint64_t page_num) {
+   if (page_num < pager->pages_capacity) {
+      return;
+   }
+   uint64_t capacity = pager->pages_capacity ? pager->pages_capacity : 64;
+   while (capacity <= page_num) {
+      capacity *= 2;
+   }
+   void** pages = heap_realloc(pager->pages, capacity * sizeof(void*));
+   uint8_t* dirty = heap_realloc(pager->dirty, capacity);
+   memset(pages + pager->pages_capacity, 0, (capacity - pager->pages_capacity) * sizeof(void*));
+   memset(dirty + pager->pages_capacity, 0, capacity - pager->pages_capacity);
+   pager->pages = pages;
+   pager->dirty = dirty;
+   pager->pages_capacity = capacity;
+}
+
+//文件里已经有的页数，之后的页还没写过盘
+uint64_t pager_file_pages(Pager* pager) {
+   return pager->file_length >> pager->page_size_shift;
+}
+
+/*
+   读页出错或者页号越界时记下错误，返回一个空的叶节点代替真实的页，
+   当前语句的查找和扫描都能正常走完。之后 db_step 直接报错，pager_flush 也不再写文件，
+   所以不管这一页被改成什么样都不会落盘
+*/
+void* pager_error_page(Pager* pager, DbResult error) {
+   if (pager->error == DB_OK) {
+      pager->error = error;
+   }
+   if (pager->error_page == NULL) {
+      pager->error_page = arena_alloc(pager->arena);
+   }
+   memset(pager->error_page, 0, pager->page_size);
+   set_node_type(pager->error_page, NODE_LEAF);
+   return pager->error_page;
+}
+
+void* get_page(Pager* pager, uint64_t page_num) {
+   if (page_num > pager->num_pages) {
+      //只能访问已有的页，或者在末尾新建一页，越界说明文件损坏
+      return pager_error_page(pager, DB_ERROR_CORRUPT);
+   }
+   pager_reserve(pager, page_num);
+
+   if (pager->pages[page_num] == NULL) {
+      // 缓存未命中，分配内存并从磁盘加载
+      STAT_INC(STAT_PAGE_MISS);
+      uint64_t start = stats_now_ns();
+      void* page = arena_alloc(pager->arena);
+
+      if (page_num < pager_file_pages(pager)) {
+         IoRequest request = {page, (uint64_t)page_num << pager->page_size_shift, pager->page_size};
+         if (io_read(pager->io, &request, 1) != 0) {
+            arena_free(pager->arena, page);
+            return pager_error_page(pager, DB_ERROR_IO);
+         }
+      } else {
+         //新页，关闭时一定要写回，否则文件中间会留下空洞
+         memset(page, 0, pager->page_size);
+         pager->dirty[page_num] = true;
+      }
+
+      pager->pages[page_num] = page;
+
+      if(page_num >= pager->num_pages) {
+         pager->num_pages = page_num + 1;
+      }
+      stats_record_time(TIMER_PAGER_READ, start);
+   } else {
+      STAT_INC(STAT_PAGE_HIT);
+   }
+
+   return pager->pages[page_num];
+}
+
+//页已经在缓存里时返回它，否则返回 NULL，不读文件
+void* pager_cached_page(Pager* pager, uint64_t page_num) {
+   return page_num < pager->pages_capacity ? pager->pages[page_num] : NULL;
+}
+
+/*
+   要修改的页通过它获取，关闭时只写回脏页
+*/
+void* get_page_for_write(Pager* pager, uint64_t page_num) {
+   void* page = get_page(pager, page_num);
+   if (pager->error != DB_OK) {
+      return page; //不会再写文件，页号也可能越界
+   }
+   pager->dirty[page_num] = true;
+   return page;
+}
+
+/*
+   扫描预读的窗口：一次最多读1MB，页越大读的页越少。页帧不会被换出，
+   窗口不设上限的话一次就可能把整个父节点下的几千个叶节点都读进内存
+*/
+#define SCAN_PREFETCH_SIZE (1024 * 1024)
+#define SCAN_PREFETCH_MAX_PAGES (SCAN_PREFETCH_SIZE / DB_MIN_PAGE_SIZE)
+
+/*
+   把还没缓存的页一次批量读进来(io_uring 下是一次系统调用)，count 不超过 SCAN_PREFETCH_MAX_PAGES
+*/
+void pager_prefetch(Pager* pager, const uint64_t* page_nums, uint32_t count) {
+   if (count == 0) {
+      return; //叶节点是父节点的最后一个孩子，没有可预读的
+   }
+   uint64_t start = stats_now_ns();
+   IoRequest requests[SCAN_PREFETCH_MAX_PAGES];
+   uint32_t num_requests = 0;
+   for (uint32_t i = 0; i < count; i++) {
+      uint64_t page_num = page_nums[i];
+      if (page_num >= pager_file_pages(pager)) {
+         continue;
+      }
+      pager_reserve(pager, page_num);
+      if (pager->pages[page_num] != NULL) {
+         continue;
+      }
+      pager->pages[page_num] = arena_alloc(pager->arena);
+      requests[num_requests].buffer = pager->pages[page_num];
+      requests[num_requests].offset = (uint64_t)page_num << pager->page_size_shift;
+      requests[num_requests].length = pager->page_size;
+      num_requests++;
+   }
+   if (num_requests == 0) {
+      return;
+   }
+   if (io_read(pager->io, requests, num_requests) != 0) {
+      //预读失败不算错，这些页之后用到时再单独读一次
+      for (uint32_t i = 0; i < num_requests; i++) {
+         uint64_t page_num = requests[i].offset >> pager->page_size_shift;
+         arena_free(pager->arena, pager->pages[page_num]);
+         pager->pages[page_num] = NULL;
+      }
+      return;
+   }
+   STAT_ADD(STAT_PAGES_PREFETCHED, num_requests);
+   stats_record_time(TIMER_PAGER_READ, start);
+}
+
+/*
+   新建一个内存中的表对象，根据schema计算叶节点布局
+*/
+Table* table_new(Database* db, uint32_t table_id, const char* name,
+                 uint64_t root_page_num, const SchemaDescriptor* descriptor) {
+   Table* table = heap_alloc(sizeof(Table));
+   table->db = db;
+   table->pager = db->pager;
+   table->layout = &db->layout;
+   table->table_id = table_id;
+   strncpy(table->name, name, TABLE_NAME_SIZE - 1);
+   table->name[TABLE_NAME_SIZE - 1] = 0;
+   table->root_page_num = root_page_num;
+   table->lookup_cache = NULL;
+   memset(&table->shape, 0, sizeof(table->shape));
+   table->shape_loaded = false;
+
+   if (schema_compile(descriptor, &table->schema) != SCHEMA_SUCCESS) {
+      free(table);
+      return NULL;
+   }
+   table->leaf_node_cell_size = db->layout.key_size + table->schema.row_size; //cell大小 = key大小+value大小
+   table->leaf_node_max_cells = db->layout.leaf_node_space_for_cells / table->leaf_node_cell_size;
+   table->leaf_node_right_split_count = (table->leaf_node_max_cells + 1) / 2;
+   table->leaf_node_left_split_count =
+         (table->leaf_node_max_cells + 1) - table->leaf_node_right_split_count; //分裂时N为奇数时，左边多一个
+
+   if (db->layout.packed_keys) {
+      /*
+         差值越窄放得越多，但分裂出来的两半可能要用8字节差值，
+         所以每种宽度最多放 2*(8字节时的cell数)-1 个，保证一半放得下
+      */
+      uint32_t widest = db->layout.leaf_node_space_for_cells / (sizeof(uint64_t) + table->schema.row_size);
+      table->leaf_node_max_cells = widest;
+      for (uint32_t width = LEAF_NODE_MIN_KEY_WIDTH; width <= sizeof(uint64_t); width *= 2) {
+         uint32_t max_cells = db->layout.leaf_node_space_for_cells / (width + table->schema.row_size);
+         table->leaf_node_packed_max_cells[width >> 2] = max_cells < 2 * widest - 1 ? max_cells : 2 * widest - 1;
+      }
+   }
+   return table;
+}
+
+#define KEY_SIGN_BIT (1ull << 63)
+
+/*
+   主键值转成节点里按无符号比较的 key。版本6起翻转符号位，-5 < 1 < 3 的顺序不变，
+   最小的主键对应 key 0；更早的文件按原样存，只能放非负主键(见 table_accepts_key)。
+   32位布局的旧文件只存低32位，和原来一致
+*/
+uint64_t table_key(Table* table, int64_t value) {
+   uint64_t key = (uint64_t)value;
+   if (table->layout->signed_keys) {
+      key ^= KEY_SIGN_BIT;
+   } else if (table->layout->key_size < sizeof(uint64_t)) {
+      key = (uint32_t)key;
+   }
+   return key;
+}
+
+//旧文件的 key 按无符号数排序，负主键会排到最后，不让插入
+bool table_accepts_key(Table* table, int64_t value) {
+   return table->layout->signed_keys || value >= 0;
+}
+
+uint64_t table_row_key(Table* table, const uint8_t* row) {
+   return table_key(table, (int64_t)row_key(&table->schema, row));
+}
+
+void database_add_table(Database* db, Table* table) {
+   if (db->num_tables == db->tables_capacity) {
+      db->tables_capacity = db->tables_capacity ? db->tables_capacity * 2 : 8;
+      db->tables = heap_realloc(db->tables, db->tables_capacity * sizeof(Table*));
+   }
+   db->tables[db->num_tables++] = table;
+}
+
+Table* database_find_table(Database* db, const char* name) {
+   for (uint32_t i = 0; i < db->num_tables; i++) {
+      if (strcmp(db->tables[i]->name, name) == 0) {
+         return db->tables[i];
+      }
+   }
+   return NULL;
+}
+
+FileHeader* file_header(Database* db) {
+   return get_page(db->pager, 0);
+}
+
+void catalog_schema(Database* db, SchemaDescriptor* descriptor) {
+   memset(descriptor, 0, sizeof(SchemaDescriptor));
+   descriptor->num_columns = 4;
+   strcpy(descriptor->columns[CATALOG_COLUMN_TABLE_ID].name, "table_id");
+   descriptor->columns[CATALOG_COLUMN_TABLE_ID].type = COLUMN_INT32;
+   strcpy(descriptor->columns[CATALOG_COLUMN_NAME].name, "name");
+   descriptor->columns[CATALOG_COLUMN_NAME].type = COLUMN_CHAR;
+   descriptor->columns[CATALOG_COLUMN_NAME].length = TABLE_NAME_SIZE;
+   strcpy(descriptor->columns[CATALOG_COLUMN_ROOT_PAGE].name, "root_page");
+   descriptor->columns[CATALOG_COLUMN_ROOT_PAGE].type =
+         db->format_version >= FILE_FORMAT_VERSION_WIDE ? COLUMN_INT64 : COLUMN_INT32;
+   strcpy(descriptor->columns[CATALOG_COLUMN_SCHEMA].name, "schema");
+   descriptor->columns[CATALOG_COLUMN_SCHEMA].type = COLUMN_CHAR;
+   descriptor->columns[CATALOG_COLUMN_SCHEMA].length = sizeof(SchemaDescriptor);
+}
+
+void* catalog_field(Table* catalog, uint8_t* row, CatalogColumn column) {
+   return row + catalog->schema.offsets[column];
+}
+
+/*
+   把表登记到系统表，并加入内存中的表列表
+*/
+void catalog_insert(Database* db, Table* table) {
+   Table* catalog = db->catalog;
+   uint8_t row[ROW_MAX_SIZE];
+   memset(row, 0, sizeof(row));
+   row_set_int(&catalog->schema, row, CATALOG_COLUMN_TABLE_ID, table->table_id);
+   strncpy(catalog_field(catalog, row, CATALOG_COLUMN_NAME), table->name, TABLE_NAME_SIZE);
+   row_set_int(&catalog->schema, row, CATALOG_COLUMN_ROOT_PAGE, table->root_page_num);
+   memcpy(catalog_field(catalog, row, CATALOG_COLUMN_SCHEMA), &table->schema.descriptor, sizeof(SchemaDescriptor));
+
+   uint64_t key = table_row_key(catalog, row); //和普通表一样经过 table_key，版本6起翻转符号位
+   Cursor cursor;
+   table_find(catalog, key, &cursor);
+   leaf_node_insert(&cursor, key, row);
+
+   database_add_table(db, table);
+}
+
+/*
+   新建一张空表：分配根页并登记到系统表
+*/
+ExecuteResult create_table(Database* db, const char* name, const SchemaDescriptor* descriptor) {
+   if (db->catalog == NULL) {
+      return EXECUTE_LEGACY_FORMAT;
+   }
+   if (database_find_table(db, name) != NULL) {
+      return EXECUTE_TABLE_EXISTS;
+   }
+
+   uint32_t table_id = 1;
+   for (uint32_t i = 0; i < db->num_tables; i++) {
+      if (db->tables[i]->table_id >= table_id) {
+         table_id = db->tables[i]->table_id + 1;
+      }
+   }
+
+   uint64_t root_page_num = get_unused_page_num(db->pager);
+   Table* table = table_new(db, table_id, name, root_page_num, descriptor);
+   if (table == NULL) {
+      return EXECUTE_TABLE_FULL;
+   }
+   void* root_node = get_page_for_write(db->pager, root_page_num);
+   initialize_leaf_node(table, root_node);
+   set_node_root(root_node, true);
+   table->shape = (TreeShape){.height = 1, .leaf_nodes = 1, .rows_known = true};
+   table->shape_loaded = true;
+
+   catalog_insert(db, table);
+   return EXECUTE_SUCCESS;
+}
+
+/*
+   把系统表里登记的表全部读进内存
+*/
+DbResult load_catalog(Database* db) {
+   Table* catalog = db->catalog;
+   if (catalog->root_page_num >= db->pager->num_pages) {
+      return DB_ERROR_CORRUPT; //文件被截断了
+   }
+   Cursor cursor;
+   table_start(catalog, &cursor);
+   while (!cursor.end_of_table) {
+      uint8_t* row = cursor_value(&cursor);
+      char name[TABLE_NAME_SIZE];
+      SchemaDescriptor descriptor;
+      uint32_t table_id = (uint32_t)row_get_int(&catalog->schema, row, CATALOG_COLUMN_TABLE_ID);
+      memcpy(name, catalog_field(catalog, row, CATALOG_COLUMN_NAME), TABLE_NAME_SIZE);
+      name[TABLE_NAME_SIZE - 1] = 0;
+      uint64_t root_page_num = (uint64_t)row_get_int(&catalog->schema, row, CATALOG_COLUMN_ROOT_PAGE);
+      memcpy(&descriptor, catalog_field(catalog, row, CATALOG_COLUMN_SCHEMA), sizeof(descriptor));
+      if (root_page_num >= db->pager->num_pages) {
+         return DB_ERROR_CORRUPT;
+      }
+
+      Table* table = table_new(db, table_id, name, root_page_num, &descriptor);
+      if (table == NULL) {
+         return DB_ERROR_CORRUPT; //系统表里登记的 schema 损坏
+      }
+      database_add_table(db, table);
+      cursor_advance(&cursor);
+   }
+   return DB_OK;
+}
+
+/*
+   新建系统表，返回它的根页号
+*/
+uint64_t create_catalog(Database* db) {
+   SchemaDescriptor descriptor;
+   catalog_schema(db, &descriptor);
+
+   uint64_t root_page_num = get_unused_page_num(db->pager);
+   db->catalog = table_new(db, 0, "catalog", root_page_num, &descriptor);
+   void* root_node = get_page_for_write(db->pager, root_page_num);
+   initialize_leaf_node(db->catalog, root_node);
+   set_node_root(root_node, true);
+   return root_page_num;
+}
+
+/*
+   在读任何一页之前从文件开头读出页大小。旧格式的文件页大小都是4KB
+*/
+DbResult file_page_size(Pager* pager, uint32_t* page_size) {
+   //O_DIRECT 要求对齐的缓冲区和长度，按最小页大小读
+   FileHeader* header = io_alloc_buffer(DB_MIN_PAGE_SIZE);
+   IoRequest request = {header, 0, DB_MIN_PAGE_SIZE};
+   DbResult result = DB_OK;
+   *page_size = LEGACY_PAGE_SIZE;
+   if (io_read(pager->io, &request, 1) != 0) {
+      result = DB_ERROR_IO;
+   } else if (memcmp(header->magic, FILE_HEADER_MAGIC, FILE_HEADER_MAGIC_SIZE) == 0 &&
+              header->format_version >= FILE_FORMAT_VERSION_PAGE_SIZE) {
+      *page_size = header->page_size;
+      if (!page_size_valid(*page_size)) {
+         result = DB_ERROR_CORRUPT;
+      }
+   }
+   free(header);
+   return result;
+}
+
+void db_default_options(DatabaseOptions* options) {
+   options->page_size = DB_DEFAULT_PAGE_SIZE;
+   options->io_backend = DB_IO_SYNC;
+   options->direct_io = false;
+   options->huge_pages = false;
+   options->lookup_cache_size = 0;
+}
+
+Database* db_open(const char* filename) {
+   DatabaseOptions options;
+   db_default_options(&options);
+   Database* db;
+   db_open_with_options(filename, &options, &db);
+   return db;
+}
+
+DbResult db_load(Database* db);
+int db_free(Database* db);
+
+//打开一个db文件并跟踪其大小，并且初始化pager和所有表
+DbResult db_open_with_options(const char* filename, const DatabaseOptions* options, Database** db_out) {
+   *db_out = NULL;
+   if (!page_size_valid(options->page_size)) {
+      return DB_ERROR_PAGE_SIZE;
+   }
+   Pager* pager = pager_open(filename, options);
+   if (pager == NULL) {
+      return DB_ERROR_OPEN;
+   }
+
+   Database* db = (Database*)heap_alloc(sizeof(Database));
+   db->pager = pager;
+   db->free_statements = NULL;
+   db->catalog = NULL;
+   db->num_tables = 0;
+   db->tables_capacity = 0;
+   db->tables = NULL;
+   db->lookup_cache_size = 0;
+   if (options->lookup_cache_size > 0) {
+      uint32_t requested = options->lookup_cache_size < DB_MAX_LOOKUP_CACHE_SIZE ?
+                           options->lookup_cache_size : DB_MAX_LOOKUP_CACHE_SIZE;
+      db->lookup_cache_size = 1;
+      while (db->lookup_cache_size < requested) {
+         db->lookup_cache_size <<= 1; //向上取到2的幂，用位与代替取模
+      }
+   }
+
+   uint32_t page_size = options->page_size;
+   DbResult result = DB_OK;
+   if (pager->file_length > 0) {
+      result = file_page_size(pager, &page_size);
+   }
+   if (result == DB_OK) {
+      result = pager_set_page_size(pager, page_size);
+   }
+   if (result == DB_OK) {
+      result = db_load(db);
+   }
+   if (result == DB_OK) {
+      result = pager->error; //读页出错或页号越界
+   }
+   if (result != DB_OK) {
+      db_free(db);
+      return result;
+   }
+   *db_out = db;
+   return DB_OK;
+}
+
+/*
+   根据文件头建立节点布局并加载所有表，新文件在这里写好文件头、系统表和默认表
+*/
+DbResult db_load(Database* db) {
+   Pager* pager = db->pager;
+   SchemaDescriptor descriptor;
+   if (pager->num_pages == 0) {
+      //新数据库文件，page0为文件头，随后是系统表和默认表
+      FileHeader* header = get_page_for_write(pager, 0);
+      memset(header, 0, pager->page_size);
+      memcpy(header->magic, FILE_HEADER_MAGIC, FILE_HEADER_MAGIC_SIZE);
+      header->format_version = FILE_FORMAT_VERSION;
+      header->page_size = pager->page_size;
+      db->format_version = FILE_FORMAT_VERSION;
+      node_layout_init(&db->layout, db->format_version, pager->page_size);
+      header->catalog_root_page = create_catalog(db);
+
+      schema_default(&descriptor);
+      create_table(db, DEFAULT_TABLE_NAME, &descriptor);
+      return DB_OK;
+   }
+
+   FileHeader* header = file_header(db);
+   if (pager->error != DB_OK) {
+      return pager->error;
+   }
+   if (memcmp(header->magic, FILE_HEADER_MAGIC, FILE_HEADER_MAGIC_SIZE) != 0) {
+      //旧格式：page0就是唯一一张表的根节点
+      db->format_version = 0;
+      node_layout_init(&db->layout, db->format_version, pager->page_size);
+      schema_default(&descriptor);
+      database_add_table(db, table_new(db, 1, DEFAULT_TABLE_NAME, 0, &descriptor));
+      return DB_OK;
+   }
+
+   if (header->format_version == 1) {
+      //升级到版本2：新建系统表，把原来唯一的表登记进去。节点布局不变，仍是32位
+      header = get_page_for_write(pager, 0);
+      descriptor = header->schema;
+      uint64_t root_page_num = header->root_page_num;
+      header->format_version = FILE_FORMAT_VERSION_CATALOG;
+      db->format_version = FILE_FORMAT_VERSION_CATALOG;
+      node_layout_init(&db->layout, db->format_version, pager->page_size);
+      header->catalog_root_page_num = create_catalog(db);
+
+      Table* table = table_new(db, 1, DEFAULT_TABLE_NAME, root_page_num, &descriptor);
+      if (table == NULL) {
+         return DB_ERROR_CORRUPT;
+      }
+      catalog_insert(db, table);
+      return DB_OK;
+   }
+
+   if (header->format_version < FILE_FORMAT_VERSION_CATALOG || header->format_version > FILE_FORMAT_VERSION) {
+      return DB_ERROR_VERSION;
+   }
+   db->format_version = header->format_version;
+   node_layout_init(&db->layout, db->format_version, pager->page_size);
+
+   uint64_t catalog_root_page_num = db->format_version >= FILE_FORMAT_VERSION_WIDE ?
+         header->catalog_root_page : header->catalog_root_page_num;
+   catalog_schema(db, &descriptor);
+   db->catalog = table_new(db, 0, "catalog", catalog_root_page_num, &descriptor);
+   return load_catalog(db);
+}
+
+//返回一个指针，指向cursor所指的行
+void* cursor_value(Cursor* cursor) {
+   uint64_t page_num = cursor->page_num;
+   void* page = get_page(cursor->table->pager, page_num);
+   return leaf_node_value(cursor->table, page, cursor->cell_num);
+}
+
+/*
+   表名最多 TABLE_NAME_SIZE-1 个字符，格式串里的宽度要和它一致
+*/
+#define TABLE_NAME_FORMAT "%31[A-Za-z0-9_]%n"
+
+//表名后面必须是空白或者语句结尾
+bool table_name_ends(const char* sql, int consumed) {
+   return sql[consumed] == 0 || sql[consumed] == ' ' || sql[consumed] == '\t';
+}
+
+/*
+   解析 " where <主键列> = <值>"，目前只支持按主键的点查询
+*/
+PrepareResult prepare_where(Statement* statement, const char* sql) {
+   Table* table = statement->table;
+   char column[COLUMN_NAME_SIZE];
+   long long value;
+   int consumed = 0;
+   if (sscanf(sql, " where %31[A-Za-z0-9_] = %lld %n", column, &value, &consumed) != 2 ||
+       consumed == 0 || sql[consumed] != 0) {
+      return PREPARE_SYNTAX_ERROR;
+   }
+   if (strcmp(column, table->schema.descriptor.columns[0].name) != 0) {
+      return PREPARE_SYNTAX_ERROR;
+   }
+   if (table->schema.descriptor.columns[0].type == COLUMN_INT32 && (value < INT32_MIN || value > INT32_MAX)) {
+      return PREPARE_SYNTAX_ERROR;
+   }
+   statement->point_lookup = true;
+   statement->lookup_key = table_key(table, value);
+   return PREPARE_SUCCESS;
+}
+
+//检测insert、select 还是 create table，并判断语法
+PrepareResult prepare_statement(Database* db, const char* sql, Statement* statement) {
+   char name[TABLE_NAME_SIZE] = DEFAULT_TABLE_NAME;
+   int consumed = 0;
+
+   if (strncmp(sql, "insert", 6)==0) {
+      statement->type = STATEMENT_INSERT;
+      const char* values = sql + 6;
+      if (sscanf(sql, "insert into " TABLE_NAME_FORMAT, name, &consumed) == 1) {
+         if (!table_name_ends(sql, consumed)) {
+            return PREPARE_SYNTAX_ERROR;
+         }
+         values = sql + consumed;
+      }
+      statement->table = database_find_table(db, name);
+      if (statement->table == NULL) {
+         return PREPARE_UNKNOWN_TABLE;
+      }
+      PrepareResult result = row_parse(&statement->table->schema, values, statement->row);
+      if (result == PREPARE_SUCCESS &&
+          !table_accepts_key(statement->table, (int64_t)row_key(&statement->table->schema, statement->row))) {
+         return PREPARE_NEGATIVE_KEY;
+      }
+      return result;
+   }
+   if (strncmp(sql, "select", 6) == 0) {
+      statement->type = STATEMENT_SELECT;
+      const char* rest = sql + 6;
+      if (*rest != 0) {
+         if (sscanf(sql, "select * from " TABLE_NAME_FORMAT, name, &consumed) != 1 ||
+             !table_name_ends(sql, consumed)) {
+            return PREPARE_SYNTAX_ERROR;
+         }
+         rest = sql + consumed;
+      }
+      statement->table = database_find_table(db, name);
+      if (statement->table == NULL) {
+         return PREPARE_UNKNOWN_TABLE;
+      }
+      if (*rest != 0) {
+         return prepare_where(statement, rest);
+      }
+      return PREPARE_SUCCESS;
+   }
+   if (strncmp(sql, "create table", 12) == 0) {
+      statement->type = STATEMENT_CREATE;
+      if (sscanf(sql, "create table " TABLE_NAME_FORMAT, statement->table_name, &consumed) != 1) {
+         return PREPARE_SYNTAX_ERROR;
+      }
+      switch (schema_parse(sql + consumed, &statement->schema_to_create)) {
+         case (SCHEMA_SUCCESS):
+            break;
+         case (SCHEMA_SYNTAX_ERROR):
+            return PREPARE_SYNTAX_ERROR;
+         default:
+            return PREPARE_INVALID_SCHEMA;
+      }
+      Schema compiled;
+      if (schema_compile(&statement->schema_to_create, &compiled) != SCHEMA_SUCCESS) {
+         return PREPARE_INVALID_SCHEMA;
+      }
+      if (compiled.descriptor.columns[0].type == COLUMN_INT64 && db->layout.key_size < sizeof(uint64_t)) {
+         return PREPARE_INVALID_SCHEMA; //32位布局的旧文件放不下 bigint 主键
+      }
+      return PREPARE_SUCCESS;
+   }
+
+   return PREPARE_UNRECOGNIZED_STATEMENT;
+}
+
+/*
+   行在内存里和在页里布局相同(见 schema_compile)，整行一次拷贝
+*/
+void serialize_row(Table* table, uint8_t* source, void* destination) {
+   memcpy(destination, source, table->schema.row_size);
+}
+
+void deserialize_row(Table* table, void *source, uint8_t* destination) {
+   memcpy(destination, source, table->schema.row_size);
+}
+
+/*
+   所有脏页作为一批提交写回。出过错的 pager 不再写，返回那个错误；写失败时脏页保持为脏。
+   这是唯一写db文件的地方，备份进行中不能调用(见 db_backup)
+*/
+DbResult pager_flush(Pager* pager) {
+   if (pager->error != DB_OK) {
+      return pager->error;
+   }
+   uint64_t start = stats_now_ns();
+   uint64_t num_dirty = 0;
+   for (uint64_t i = 0; i < pager->num_pages && i < pager->pages_capacity; i++) {
+      num_dirty += pager->dirty[i] && pager->pages[i] != NULL;
+   }
+   if (num_dirty == 0) {
+      return DB_OK;
+   }
+
+   IoRequest* requests = heap_alloc(num_dirty * sizeof(IoRequest));
+   uint64_t count = 0;
+   for (uint64_t i = 0; i < pager->num_pages && i < pager->pages_capacity; i++) {
+      if (!pager->dirty[i] || pager->pages[i] == NULL) {
+         continue;
+      }
+      requests[count].buffer = pager->pages[i];
+      requests[count].offset = (uint64_t)i << pager->page_size_shift;
+      requests[count].length = pager->page_size;
+      count++;
+   }
+   int error = io_write(pager->io, requests, count);
+   free(requests);
+   if (error != 0) {
+      return DB_ERROR_IO;
+   }
+
+   memset(pager->dirty, 0, pager->pages_capacity);
+   if ((pager->num_pages << pager->page_size_shift) > pager->file_length) {
+      pager->file_length = pager->num_pages << pager->page_size_shift;
+   }
+   stats_record_time(TIMER_PAGER_FLUSH, start);
+   return DB_OK;
+}
+
+/*
+   在线备份(.backup)。开始时先把脏页写回，这一刻的db文件就是备份的内容，
+   后台线程按块把它拷贝到备份文件，前台同时继续执行语句。
+   不需要给被修改的页留副本：修改只落在 pager 的缓存里，db文件只有 pager_flush 会写，
+   而 pager_flush 只在 db_backup 和 db_close 里调用，两处都先等上一个备份结束。
+   所以备份进行期间db文件不会变，后台读到的一定是快照时的内容
+*/
+#define BACKUP_CHUNK_SIZE IO_COPY_BUFFER_SIZE
+
+struct Backup {
+   pthread_t thread;
+   pthread_mutex_t lock;     //保护 copied_pages 和 state
+   int source_fd;
+   int destination_fd;
+   uint32_t page_size;
+   uint64_t snapshot_pages;
+   uint64_t copied_pages;    //[0, copied_pages) 已经写进备份
+   BackupState state;
+};
+
+void* backup_main(void* argument) {
+   Backup* backup = argument;
+   uint32_t chunk_pages = BACKUP_CHUNK_SIZE / backup->page_size;
+   int error = 0;
+
+   for (uint64_t first = 0; first < backup->snapshot_pages && error == 0; first += chunk_pages) {
+      uint64_t count = backup->snapshot_pages - first;
+      if (count > chunk_pages) {
+         count = chunk_pages;
+      }
+      error = io_copy_range(backup->source_fd, backup->destination_fd,
+                            first * backup->page_size, count * backup->page_size);
+
+      pthread_mutex_lock(&backup->lock);
+      backup->copied_pages = first + count;
+      pthread_mutex_unlock(&backup->lock);
+      STAT_ADD(STAT_BACKUP_PAGES, count);
+   }
+   if (error == 0 && fsync(backup->destination_fd) == -1) {
+      error = errno;
+   }
+
+   pthread_mutex_lock(&backup->lock);
+   backup->state = error == 0 ? BACKUP_FINISHED : BACKUP_FAILED;
+   pthread_mutex_unlock(&backup->lock);
+   return NULL;
+}
+
+/*
+   备份线程结束后回收线程和备份文件。wait 为 true 时等它结束，
+   否则还在进行时直接返回 BACKUP_RUNNING
+*/
+BackupState backup_reap(Pager* pager, bool wait) {
+   Backup* backup = pager->backup;
+   if (backup == NULL) {
+      return BACKUP_IDLE;
+   }
+   pthread_mutex_lock(&backup->lock);
+   BackupState state = backup->state;
+   pthread_mutex_unlock(&backup->lock);
+   if (state == BACKUP_RUNNING && !wait) {
+      return BACKUP_RUNNING;
+   }
+
+   pthread_join(backup->thread, NULL);
+   state = backup->state;
+   if (close(backup->destination_fd) == -1) {
+      state = BACKUP_FAILED;
+   }
+   pthread_mutex_destroy(&backup->lock);
+   free(backup);
+   pager->backup = NULL;
+   return state;
+}
+
+BackupResult db_backup(Database* db, const char* path, uint64_t* total_pages) {
+   Pager* pager = db->pager;
+   if (pager->backup != NULL) {
+      //还在进行，或者已经结束但结果还没经 db_backup_status 取走，不能悄悄丢掉
+      return BACKUP_BUSY;
+   }
+   //先不截断：path 可能就是正在用的db文件(或它的硬链接)，确认不是之后才清空
+   int fd = open(path, O_WRONLY | O_CREAT, S_IWUSR | S_IRUSR);
+   if (fd == -1) {
+      return BACKUP_OPEN_FAILED;
+   }
+   struct stat source;
+   struct stat destination;
+   if (fstat(pager->file_descriptor, &source) == -1 || fstat(fd, &destination) == -1) {
+      close(fd);
+      return BACKUP_OPEN_FAILED;
+   }
+   if (source.st_dev == destination.st_dev && source.st_ino == destination.st_ino) {
+      close(fd);
+      return BACKUP_SAME_FILE;
+   }
+   if (ftruncate(fd, 0) == -1) {
+      close(fd);
+      return BACKUP_OPEN_FAILED;
+   }
+
+   if (pager_flush(pager) != DB_OK) { //检查点
+      close(fd);
+      return BACKUP_DB_ERROR;
+   }
+
+   Backup* backup = heap_alloc(sizeof(Backup));
+   pthread_mutex_init(&backup->lock, NULL);
+   backup->source_fd = pager->file_descriptor;
+   backup->destination_fd = fd;
+   backup->page_size = pager->page_size;
+   backup->snapshot_pages = pager->num_pages;
+   backup->copied_pages = 0;
+   backup->state = BACKUP_RUNNING;
+
+   if (pthread_create(&backup->thread, NULL, backup_main, backup) != 0) {
+      pthread_mutex_destroy(&backup->lock);
+      free(backup);
+      close(fd);
+      return BACKUP_THREAD_FAILED;
+   }
+   pager->backup = backup;
+   *total_pages = backup->snapshot_pages;
+   return BACKUP_STARTED;
+}
+
+BackupState db_backup_status(Database* db, uint64_t* copied_pages, uint64_t* total_pages) {
+   Backup* backup = db->pager->backup;
+   if (backup == NULL) {
+      return BACKUP_IDLE;
+   }
+   pthread_mutex_lock(&backup->lock);
+   *copied_pages = backup->copied_pages;
+   *total_pages = backup->snapshot_pages;
+   pthread_mutex_unlock(&backup->lock);
+   return backup_reap(db->pager, false);
+}
+
+DbResult db_close(Database* db) {
+   backup_reap(db->pager, true);
+   DbResult result = pager_flush(db->pager);
+   if (db_free(db) == -1 && result == DB_OK) {
+      result = DB_ERROR_IO; //关闭文件失败
+   }
+   return result;
+}
+
+DbResult db_error(Database* db) {
+   return db->pager->error;
+}
+
+//释放句柄，不写回，返回 close 的结果。打开失败时也用它清理，这时 pager 可能还没设置页大小
+int db_free(Database* db) {
+   Pager* pager = db->pager;
+   io_close(pager->io);
+   int result = close(pager->file_descriptor);
+   if (pager->arena != NULL) {
+      arena_close(pager->arena); //所有页帧一起归还
+   }
+   free(pager->pages);
+   free(pager->dirty);
+   free(pager);
+   for (uint32_t i = 0; i < db->num_tables; i++) {
+      free(db->tables[i]->lookup_cache);
+      free(db->tables[i]);
+   }
+   free(db->tables);
+   free(db->catalog);
+   while (db->free_statements != NULL) {
+      Statement* statement = db->free_statements;
+      db->free_statements = statement->next_free;
+      free(statement);
+   }
+   free(db);
+   return result;
+}
+
+void print_constants(Table* table) {
+   const NodeLayout* layout = table->layout;
+   printf("PAGE_SIZE: %d\n", table->pager->page_size);
+   printf("ROW_SIZE: %d\n", table->schema.row_size);
+   printf("KEY_SIZE: %d\n", layout->key_size);
+   printf("PAGE_NUM_SIZE: %d\n", layout->page_num_size);
+   printf("COMMON_NODE_HEADER_SIZE: %d\n", layout->common_node_header_size);
+   printf("LEAF_NODE_HEADER_SIZE: %d\n", layout->leaf_node_header_size);
+   printf("LEAF_NODE_CELL_SIZE: %d\n", table->leaf_node_cell_size);
+   printf("LEAF_NODE_SPACE_FOR_CELLS: %d\n", layout->leaf_node_space_for_cells);
+   if (layout->packed_keys) {
+      printf("LEAF_NODE_MAX_CELLS (2/4/8 byte key deltas): %d / %d / %d\n",
+             table->leaf_node_packed_max_cells[0], table->leaf_node_packed_max_cells[1],
+             table->leaf_node_packed_max_cells[2]);
+   } else {
+      printf("LEAF_NODE_MAX_CELLS: %d\n", table->leaf_node_max_cells);
+   }
+   printf("INTERNAL_NODE_MAX_CELLS: %d\n", layout->internal_node_max_cells);
+}
+
+void printf_leaf_node(Table* table, void* node) {
+   uint32_t num_cells = *leaf_node_num_cells(table, node);
+   printf("leaf (size %d)\n", num_cells);
+   for (uint32_t i = 0;i < num_cells; i++) {
+      uint64_t key = leaf_node_key(table, node, i);
+      printf("  - %d : %llu\n", i, (unsigned long long)key);
+   }
+}
+
+uint32_t internal_node_find_child(Table* table, void* node, uint64_t key) {
+   uint32_t num_keys = *internal_node_num_keys(table, node);
+
+   /*
+      二分搜索
+   */
+  uint32_t min_index = 0;
+  uint32_t max_index = num_keys;
+
+  while(min_index != max_index) {
+   uint32_t index = (min_index + max_index) / 2;
+   uint64_t key_to_right = internal_node_key(table, node, index);
+   if (key_to_right >= key) {
+      max_index = index;
+   } else {
+      min_index = index + 1;
+   }
+  }
+
+  return min_index;
+}
+
+/*
+   在压缩叶节点的差值数组上直接二分：要找的 key 先换算成差值，比较时不用还原每个 key。
+   返回第一个 >= key 的 cell
+*/
+uint32_t leaf_node_find_packed(Table* table, void* node, uint32_t num_cells, uint64_t key) {
+   uint64_t base = leaf_node_key_base(table, node);
+   if (num_cells == 0 || key <= base) {
+      return 0;
+   }
+   uint32_t width = leaf_node_key_width(table, node);
+   uint64_t delta = key - base;
+   if (width < sizeof(uint64_t) && (delta >> (width * 8)) != 0) {
+      return num_cells; //比这个宽度能表示的都大
+   }
+
+   void* deltas = leaf_node_key_deltas(table, node);
+   uint32_t min_index = 0;
+   uint32_t one_past_max_index = num_cells;
+   while (one_past_max_index != min_index) {
+      uint32_t index = (min_index + one_past_max_index) / 2;
+      if (node_read(deltas + index * width, width) < delta) {
+         min_index = index + 1;
+      } else {
+         one_past_max_index = index;
+      }
+   }
+   return min_index;
+}
+
+void leaf_node_find(Table* table, uint64_t page_num, uint64_t key, Cursor* cursor) {
+   void* node = get_page(table->pager, page_num);
+   uint32_t num_cells = *leaf_node_num_cells(table, node);
+
+   cursor->table = table;
+   cursor->page_num = page_num;
+   cursor->end_of_table = false;
+
+   if (table->layout->packed_keys) {
+      cursor->cell_num = leaf_node_find_packed(table, node, num_cells, key);
+      return;
+   }
+
+   //二分查找
+   uint32_t min_index = 0;
+   uint32_t one_past_max_index = num_cells;
+   while (one_past_max_index != min_index) {
+      uint32_t index = (min_index + one_past_max_index) / 2;
+      uint64_t key_at_index = leaf_node_key(table, node, index);
+      if (key == key_at_index) {
+         cursor->cell_num = index;
+         return;//找到，返回cell位置
+      }
+      if (key < key_at_index) {
+         one_past_max_index = index;
+      } else {
+         min_index = index + 1;
+      }
+   }
+
+   cursor->cell_num = min_index;
+}
+
+NodeType get_node_type(void* node) {
+   uint8_t value = *((uint8_t*)(node + NODE_TYPE_OFFSET));
+   return (NodeType)value;
+}
+
+void internal_node_find(Table* table, uint64_t page_num, uint64_t key, Cursor* cursor) {
+  void* node = get_page(table->pager, page_num);
+   /*
+      找到后的子节点可能是叶节点也可能是内部节点
+   */
+  uint32_t child_index = internal_node_find_child(table, node, key);
+  uint64_t child_num = internal_node_child(table, node, child_index);
+  void* child = get_page(table->pager, child_num);
+  switch (get_node_type(child)) {
+      case NODE_LEAF:
+         leaf_node_find(table, child_num, key, cursor);
+         break;
+      case NODE_INTERNAL:
+      default:
+         internal_node_find(table, child_num, key, cursor);
+         break;
+  }
+}
+
+/*
+   把光标定位到给定key的位置，如果key不存在，定位到它应该插入的位置。
+   光标由调用者提供(通常在栈上或语句里)，查找过程不分配内存
+*/
+void table_find(Table* table, uint64_t key, Cursor* cursor) {
+   uint64_t start = stats_now_ns();
+   uint64_t root_page_num = table->root_page_num;
+   void* root_node = get_page(table->pager, root_page_num);
+
+   if (get_node_type(root_node) == NODE_LEAF) {
+      leaf_node_find(table, root_page_num, key, cursor); //是叶节点，在节点里查找
+   } else {
+      internal_node_find(table, root_page_num, key, cursor);
+   }
+   stats_record_time(TIMER_SEARCH, start);
+}
+
+//把光标定位到表头，key 0 是最小的 key(版本6起对应 INT64_MIN)
+void table_start(Table* table, Cursor* cursor) {
+   table_find(table, 0, cursor);
+
+   void* node = get_page(table->pager, cursor->page_num);
+   uint32_t num_cells = *leaf_node_num_cells(table, node);
+   cursor->end_of_table = (num_cells == 0);
+}
+
+void set_node_type(void* node, NodeType type) {
+   uint8_t value = type;
+   *((uint8_t*)(node + NODE_TYPE_OFFSET)) = value;
+}
+/*
+   返回该节点的父节点
+*/
+uint64_t node_parent(Table* table, void* node) {
+   return node_read(node + PARENT_POINTER_OFFSET, table->layout->page_num_size);
+}
+
+void set_node_parent(Table* table, void* node, uint64_t page_num) {
+   node_write(node + PARENT_POINTER_OFFSET, table->layout->page_num_size, page_num);
+}
+
+void update_internal_node_key(Table* table, void* node, uint64_t old_key, uint64_t new_key) {
+   uint32_t old_child_index = internal_node_find_child(table, node, old_key);
+   if (old_child_index < *internal_node_num_keys(table, node)) {
+      //右孩子没有对应的key
+      set_internal_node_key(table, node, old_child_index, new_key);
+   }
+}
+
+/*
+   内部节点的最大key在最右边的子树里
+*/
+uint64_t get_node_max_key(Table* table, void* node) {
+   switch (get_node_type(node)) {
+      case NODE_INTERNAL:
+         return get_node_max_key(table, get_page(table->pager, internal_node_right_child(table, node)));
+      case NODE_LEAF:
+      default:
+         return leaf_node_key(table, node, *leaf_node_num_cells(table, node) - 1);
+   }
+}
+
+void internal_node_insert(Table* table, uint64_t parent_page_num, uint64_t child_page_num) {
+  /*
+  Add a new child/key pair to parent that corresponds to child
+  */
+
+  void* parent = get_page_for_write(table->pager, parent_page_num);
+  void* child = get_page_for_write(table->pager, child_page_num);
+  uint64_t child_max_key = get_node_max_key(table, child);
+  uint32_t index = internal_node_find_child(table, parent, child_max_key);
+
+  uint32_t original_num_keys = *internal_node_num_keys(table, parent);
+  if (original_num_keys >= table->layout->internal_node_max_cells) {
+      internal_node_split_and_insert(table, parent_page_num, child_page_num);
+      return;
+  }
+  *internal_node_num_keys(table, parent) = original_num_keys + 1;
+  set_node_parent(table, child, parent_page_num);
+
+  uint64_t right_child_page_num = internal_node_right_child(table, parent);
+  void* right_child = get_page(table->pager, right_child_page_num);
+
+  if (child_max_key > get_node_max_key(table, right_child)) {
+    /*
+      replace right child
+    */
+    set_internal_node_child(table, parent, original_num_keys, right_child_page_num);
+    set_internal_node_key(table, parent, original_num_keys, get_node_max_key(table, right_child));
+    set_internal_node_right_child(table, parent, child_page_num);
+  } else {
+    /*
+      make room for the new cell
+    */
+    for(uint32_t i = original_num_keys; i > index; i--) {
+      void* destination = internal_node_cell(table, parent, i);
+      void* source = internal_node_cell(table, parent, i - 1);
+      memcpy(destination, source, table->layout->internal_node_cell_size);
+    }
+    set_internal_node_child(table, parent, index, child_page_num);
+    set_internal_node_key(table, parent, index, child_max_key);
+  }
+}
+
+void internal_node_split_and_insert(Table* table, uint64_t parent_page_num, uint64_t child_page_num) {
+  /*
+  Collect every child of the full node plus the new child in key order.
+  The first half stays in the old node, the second half moves to a new node,
+  then the new node is inserted into the level above (which may split too).
+  */
+   STAT_INC(STAT_INTERNAL_SPLIT);
+   table->shape.internal_nodes++;
+   void* old_node = get_page_for_write(table->pager, parent_page_num);
+   uint64_t old_max = get_node_max_key(table, old_node);
+   void* child = get_page(table->pager, child_page_num);
+   uint64_t child_max = get_node_max_key(table, child);
+
+   uint32_t num_keys = *internal_node_num_keys(table, old_node);
+   uint32_t total = num_keys + 2; //原有 num_keys+1 个孩子，再加上新孩子
+   uint64_t children[total];
+   uint64_t keys[total];          //keys[i] 是 children[i] 子树的最大key
+   uint32_t count = 0;
+   bool inserted = false;
+   for (uint32_t i = 0; i <= num_keys; i++) {
+      uint64_t key = i < num_keys ? internal_node_key(table, old_node, i) : old_max;
+      if (!inserted && child_max < key) {
+         children[count] = child_page_num;
+         keys[count++] = child_max;
+         inserted = true;
+      }
+      children[count] = internal_node_child(table, old_node, i);
+      keys[count++] = key;
+   }
+   if (!inserted) {
+      children[count] = child_page_num;
+      keys[count++] = child_max;
+   }
+
+   uint32_t left_count = total / 2;
+   uint64_t new_page_num = get_unused_page_num(table->pager);
+   void* new_node = get_page_for_write(table->pager, new_page_num);
+   initialize_internal_node(table, new_node);
+
+   *internal_node_num_keys(table, old_node) = left_count - 1;
+   for (uint32_t i = 0; i < left_count - 1; i++) {
+      set_internal_node_child(table, old_node, i, children[i]);
+      set_internal_node_key(table, old_node, i, keys[i]);
+   }
+   set_internal_node_right_child(table, old_node, children[left_count - 1]);
+
+   *internal_node_num_keys(table, new_node) = total - left_count - 1;
+   for (uint32_t i = left_count; i < total - 1; i++) {
+      set_internal_node_child(table, new_node, i - left_count, children[i]);
+      set_internal_node_key(table, new_node, i - left_count, keys[i]);
+   }
+   set_internal_node_right_child(table, new_node, children[total - 1]);
+
+   for (uint32_t i = 0; i < total; i++) {
+      set_node_parent(table, get_page_for_write(table->pager, children[i]), i < left_count ? parent_page_num : new_page_num);
+   }
+
+   if (is_node_root(old_node)) {
+      create_new_root(table, new_page_num);
+   } else {
+      uint64_t grandparent_page_num = node_parent(table, old_node);
+      void* grandparent = get_page_for_write(table->pager, grandparent_page_num);
+
+      update_internal_node_key(table, grandparent, old_max, keys[left_count - 1]);
+      internal_node_insert(table, grandparent_page_num, new_page_num);
+   }
+}
+
+/*
+   扫描走到一个还没缓存的叶节点时，把父节点里排在它后面的叶节点批量预读一个窗口(SCAN_PREFETCH_SIZE)。
+   光标走出窗口后下一个叶节点又没缓存，再预读下一个窗口，所以内存里最多比光标多读1MB。
+   父指针不可信时(旧文件)不预读
+*/
+void cursor_prefetch_siblings(Table* table, uint64_t leaf_page_num) {
+   void* leaf = get_page(table->pager, leaf_page_num);
+   if (is_node_root(leaf)) {
+      return;
+   }
+   uint64_t parent_page_num = node_parent(table, leaf);
+   if (parent_page_num >= table->pager->num_pages) {
+      return;
+   }
+   void* parent = get_page(table->pager, parent_page_num);
+   if (get_node_type(parent) != NODE_INTERNAL) {
+      return;
+   }
+
+   uint32_t num_keys = *internal_node_num_keys(table, parent);
+   uint32_t window = SCAN_PREFETCH_SIZE / table->pager->page_size;
+   uint64_t page_nums[SCAN_PREFETCH_MAX_PAGES];
+   uint32_t count = 0;
+   bool found = false;
+   for (uint32_t i = 0; i <= num_keys && count < window; i++) {
+      uint64_t child = internal_node_child(table, parent, i);
+      if (found) {
+         page_nums[count++] = child;
+      }
+      found = found || child == leaf_page_num;
+   }
+   if (found) {
+      pager_prefetch(table->pager, page_nums, count);
+   }
+}
+
+//光标前进一行
+void cursor_advance(Cursor* cursor) {
+   uint64_t page_num = cursor->page_num;
+   void* node = get_page(cursor->table->pager, page_num);
+
+   cursor->cell_num +=1;
+   if(cursor->cell_num >= (*leaf_node_num_cells(cursor->table, node))) {
+      /*前往下一个叶节点*/
+      uint64_t next_page_num = leaf_node_next_leaf(cursor->table, node);
+      if (next_page_num == 0) {
+         /* 这是最右边的叶节点了*/
+         cursor->end_of_table = true;
+      } else {
+         Pager* pager = cursor->table->pager;
+         bool cached = pager_cached_page(pager, next_page_num) != NULL;
+         cursor->page_num = next_page_num;
+         cursor->cell_num = 0;
+         if (!cached) {
+            cursor_prefetch_siblings(cursor->table, next_page_num);
+         }
+      }
+   }
+
+}
+
+//执行insert
+/*
+   part9：插入改为顺序插入，而不是始终插入到表尾
+*/
+ExecuteResult execute_insert(Statement* statement,Table* table) {
+   uint8_t* row_to_insert = statement->row; //获取statement里要插入的row
+   uint64_t key_to_insert = table_row_key(table, row_to_insert); //按主键(第一列)排序
+   Cursor cursor;
+   table_find(table, key_to_insert, &cursor);
+
+   void* node = get_page(table->pager, cursor.page_num);
+   uint32_t num_cells = (*leaf_node_num_cells(table, node));
+
+   if(cursor.cell_num <num_cells) {
+      uint64_t key_at_index = leaf_node_key(table, node, cursor.cell_num);
+      if (key_at_index == key_to_insert) {
+         return EXECUTE_DUPLICATE_KEY;
+      } //插入了重复行
+   }
+
+   leaf_node_insert(&cursor, key_to_insert, row_to_insert);
+   STAT_INC(STAT_ROWS_INSERTED);
+   table->shape.rows++;
+
+   return EXECUTE_SUCCESS;
+}
+
+//按主键查找，最多产出一行
+LookupCacheEntry* lookup_cache_slot(Table* table, uint64_t key) {
+   if (table->lookup_cache == NULL) {
+      size_t size = (size_t)table->db->lookup_cache_size * sizeof(LookupCacheEntry);
+      table->lookup_cache = heap_alloc(size);
+      memset(table->lookup_cache, 0, size);
+   }
+   uint32_t hash = (uint32_t)((key * 0x9E3779B97F4A7C15ull) >> 32); //斐波那契散列，连续的 id 也能打散
+   return &table->lookup_cache[hash & (table->db->lookup_cache_size - 1)];
+}
+
+/*
+   缓存记录的位置上还是一个叶节点，cell 没越界，key 也对得上，才算命中。
+   key 唯一，所以核对通过的位置一定就是这一行现在的位置
+*/
+bool lookup_cache_probe(Table* table, LookupCacheEntry* entry, uint64_t key, Cursor* cursor) {
+   if (!entry->valid || entry->key != key || entry->page_num >= table->pager->num_pages) {
+      return false;
+   }
+   void* node = get_page(table->pager, entry->page_num);
+   if (get_node_type(node) != NODE_LEAF || entry->cell_num >= *leaf_node_num_cells(table, node) ||
+       leaf_node_key(table, node, entry->cell_num) != key) {
+      return false;
+   }
+   cursor->table = table;
+   cursor->page_num = entry->page_num;
+   cursor->cell_num = entry->cell_num;
+   cursor->end_of_table = false;
+   return true;
+}
+
+ExecuteResult execute_point_select(Statement* statement, Table* table) {
+   if (statement->cursor_open) {
+      return EXECUTE_SUCCESS;
+   }
+   statement->cursor_open = true;
+   uint64_t key = statement->lookup_key;
+   Cursor* cursor = &statement->cursor;
+
+   LookupCacheEntry* entry = NULL;
+   if (table->db->lookup_cache_size > 0) {
+      entry = lookup_cache_slot(table, key);
+      if (lookup_cache_probe(table, entry, key, cursor)) {
+         STAT_INC(STAT_LOOKUP_CACHE_HIT);
+         deserialize_row(table, cursor_value(cursor), statement->row);
+         STAT_INC(STAT_ROWS_READ);
+         return EXECUTE_ROW;
+      }
+      STAT_INC(STAT_LOOKUP_CACHE_MISS);
+   }
+
+   table_find(table, key, cursor);
+   void* node = get_page(table->pager, cursor->page_num);
+   if (cursor->cell_num >= *leaf_node_num_cells(table, node) ||
+       leaf_node_key(table, node, cursor->cell_num) != key) {
+      return EXECUTE_SUCCESS; //不存在的 key 不进缓存
+   }
+   if (entry != NULL) {
+      entry->key = key;
+      entry->page_num = cursor->page_num;
+      entry->cell_num = cursor->cell_num;
+      entry->valid = true;
+   }
+   deserialize_row(table, cursor_value(cursor), statement->row);
+   STAT_INC(STAT_ROWS_READ);
+   return EXECUTE_ROW;
+}
+
+//执行select，第一次调用时光标指向表头，之后每次读取一行直至表尾
+ExecuteResult execute_select(Statement* statement, Table* table) {
+   if (statement->point_lookup) {
+      return execute_point_select(statement, table);
+   }
+   if (!statement->cursor_open) {
+      table_start(table, &statement->cursor);
+      statement->cursor_open = true;
+   }
+
+   Cursor* cursor = &statement->cursor;
+   if (cursor->end_of_table) {
+      return EXECUTE_SUCCESS;
+   }
+
+   deserialize_row(table, cursor_value(cursor), statement->row); //内容拷贝到row
+   cursor_advance(cursor); //光标前进一行
+   STAT_INC(STAT_ROWS_READ);
+
+   return EXECUTE_ROW;
+}
+
+ExecuteResult execute_create(Statement* statement) {
+   return create_table(statement->db, statement->table_name, &statement->schema_to_create);
+}
+
+//根据状态选择对表的操作
+ExecuteResult execute_statement(Statement* statement, Table* table) {
+   switch (statement->type) {
+      case (STATEMENT_INSERT):
+         return execute_insert(statement, table);
+      case (STATEMENT_CREATE):
+         return execute_create(statement);
+      case (STATEMENT_SELECT) :
+      default:
+         return execute_select(statement, table);
+   }
+}
+
+/*
+   语句用完放回 db 的空闲链表，db_prepare 先从链表里取，稳定运行后不再 malloc
+*/
+void statement_release(Statement* statement) {
+   Database* db = statement->db;
+   statement->next_free = db->free_statements;
+   db->free_statements = statement;
+}
+
+PrepareResult db_prepare(Database* db, const char* sql, Statement** statement) {
+   Statement* prepared = db->free_statements;
+   if (prepared != NULL) {
+      db->free_statements = prepared->next_free;
+   } else {
+      prepared = heap_alloc(sizeof(Statement));
+   }
+   prepared->db = db;
+   prepared->table = NULL;
+   prepared->cursor_open = false;
+   prepared->point_lookup = false;
+
+   uint64_t start = stats_now_ns();
+   PrepareResult result = prepare_statement(db, sql, prepared);
+   stats_record_time(TIMER_PREPARE, start);
+   if (result != PREPARE_SUCCESS) {
+      statement_release(prepared);
+      *statement = NULL;
+      return result;
+   }
+
+   *statement = prepared;
+   return PREPARE_SUCCESS;
+}
+
+ExecuteResult db_step(Statement* statement) {
+   Pager* pager = statement->db->pager;
+   if (pager->error != DB_OK) {
+      return EXECUTE_DB_ERROR;
+   }
+   ExecuteResult result = execute_statement(statement, statement->table);
+   if (pager->error != DB_OK) {
+      return EXECUTE_DB_ERROR; //这一步读到的页不可信，产出的行也不要
+   }
+   return result;
+}
+
+void db_finalize(Statement* statement) {
+   if (statement == NULL) {
+      return;
+   }
+   statement_release(statement);
+}
+
+/*
+   实现空闲页面回收之前，目前新页面总是会加入到数据库文件末尾
+*/
+uint64_t get_unused_page_num(Pager* pager) {
+   return pager->num_pages;
+}
+
+void create_new_root(Table* table,uint64_t right_child_page_num) {
+   /*
+     Handle splitting the root.
+     Old root copied to new page, becomes left child.
+     Address of right child passed in.
+     Re-initialize root page to contain the new root node.
+     New root node points to two children.
+   */
+   STAT_INC(STAT_ROOT_SPLIT);
+   table->shape.internal_nodes++; //旧根搬到新页，根页变成新的内部节点
+   table->shape.height++;
+   void* root = get_page_for_write(table->pager, table->root_page_num);
+   void* right_child = get_page_for_write(table->pager, right_child_page_num);
+   uint64_t left_child_page_num = get_unused_page_num(table->pager);
+   void* left_child = get_page_for_write(table->pager, left_child_page_num);
+   /*
+      旧的根节点数据被复制到左子节点
+   */
+   memcpy(left_child, root, table->pager->page_size);
+   set_node_root(left_child, false);
+   if (get_node_type(left_child) == NODE_INTERNAL) {
+      //内部节点被整体搬走，它的孩子要指向新的页
+      for (uint32_t i = 0; i <= *internal_node_num_keys(table, left_child); i++) {
+         set_node_parent(table, get_page_for_write(table->pager, internal_node_child(table, left_child, i)), left_child_page_num);
+      }
+   }
+   /*
+      Root node is a new internal node with one key and two children
+   */
+   initialize_internal_node(table, root);
+   set_node_root(root, true);
+   *internal_node_num_keys(table, root) = 1;
+   set_internal_node_child(table, root, 0, left_child_page_num);
+   uint64_t left_child_max_key = get_node_max_key(table, left_child);
+   set_internal_node_key(table, root, 0, left_child_max_key);
+   set_internal_node_right_child(table, root, right_child_page_num);
+   set_node_parent(table, left_child, table->root_page_num);
+   set_node_parent(table, right_child, table->root_page_num);
+}
+
+/*
+   重新编码叶节点时，把原节点的 cell 和要插入的新 cell 看成一个有序序列：
+   第 insert_at 个是新 cell，它后面的第 i 个是原节点的第 i-1 个。
+   原节点先拷贝到 pager 的临时页，写回时不会覆盖还没读的 cell
+*/
+typedef struct {
+   Table* table;
+   void* source;
+   uint32_t insert_at;
+   uint64_t key;
+   uint8_t* value;
+} LeafMerge;
+
+void leaf_merge_begin(LeafMerge* merge, Cursor* cursor, void* node, uint64_t key, uint8_t* value) {
+   Pager* pager = cursor->table->pager;
+   if (pager->scratch == NULL) {
+      pager->scratch = arena_alloc(pager->arena);
+   }
+   memcpy(pager->scratch, node, pager->page_size);
+   merge->table = cursor->table;
+   merge->source = pager->scratch;
+   merge->insert_at = cursor->cell_num;
+   merge->key = key;
+   merge->value = value;
+}
+
+uint64_t leaf_merge_key(LeafMerge* merge, uint32_t i) {
+   if (i == merge->insert_at) {
+      return merge->key;
+   }
+   return leaf_node_key(merge->table, merge->source, i < merge->insert_at ? i : i - 1);
+}
+
+void* leaf_merge_value(LeafMerge* merge, uint32_t i) {
+   if (i == merge->insert_at) {
+      return merge->value;
+   }
+   return leaf_node_value(merge->table, merge->source, i < merge->insert_at ? i : i - 1);
+}
+
+/*
+   把序列里 [first, first+count) 的 cell 编码进 node：基准值取第一个 key，
+   差值宽度取放得下最大差值的最窄宽度。节点头里的其他字段不动
+*/
+void leaf_node_pack(LeafMerge* merge, void* node, uint32_t first, uint32_t count) {
+   Table* table = merge->table;
+   uint64_t base = leaf_merge_key(merge, first);
+   uint32_t width = leaf_key_width_for(leaf_merge_key(merge, first + count - 1) - base);
+   set_leaf_node_key_base(table, node, base);
+   set_leaf_node_key_width(table, node, width);
+   *leaf_node_num_cells(table, node) = count;
+
+   void* deltas = leaf_node_key_deltas(table, node);
+   for (uint32_t i = 0; i < count; i++) {
+      node_write(deltas + i * width, width, leaf_merge_key(merge, first + i) - base);
+      serialize_row(table, leaf_merge_value(merge, first + i), leaf_node_value(table, node, i));
+   }
+}
+
+//分裂后更新父节点，原节点是根节点时树长高一层
+void leaf_node_split_finish(Cursor* cursor, void* old_node, uint64_t old_max, uint64_t new_page_num) {
+   Table* table = cursor->table;
+   if (is_node_root(old_node)) {
+      create_new_root(table, new_page_num); //原始节点是根节点
+   } else {
+      uint64_t parent_page_num = node_parent(table, old_node);
+      uint64_t new_max = get_node_max_key(table, old_node);
+      void* parent = get_page_for_write(table->pager, parent_page_num);
+
+      update_internal_node_key(table, parent, old_max, new_max);
+      internal_node_insert(table, parent_page_num, new_page_num);
+   }
+}
+
+void leaf_node_split_and_insert(Cursor* cursor, uint64_t key, uint8_t* value) {
+  /*
+  Create a new node and move half the cells over.
+  Insert the new value in one of the two nodes.
+  Update parent or create a new parent.
+  */
+   STAT_INC(STAT_LEAF_SPLIT);
+   uint64_t start = stats_now_ns();
+   Table* table = cursor->table;
+   table->shape.leaf_nodes++;
+   void* old_node = get_page_for_write(cursor->table->pager, cursor->page_num);
+   uint64_t old_max = get_node_max_key(table, old_node);
+   uint64_t new_page_num = get_unused_page_num(cursor->table->pager);
+   void* new_node = get_page_for_write(cursor->table->pager, new_page_num);
+   initialize_leaf_node(table, new_node);
+   set_node_parent(table, new_node, node_parent(table, old_node));
+   set_leaf_node_next_leaf(table, new_node, leaf_node_next_leaf(table, old_node));
+   set_leaf_node_next_leaf(table, old_node, new_page_num);
+   if (table->layout->packed_keys) {
+      //两半各自选基准值和差值宽度，N为奇数时左边多一个
+      uint32_t total = *leaf_node_num_cells(table, old_node) + 1;
+      uint32_t left_count = total - total / 2;
+      LeafMerge merge;
+      leaf_merge_begin(&merge, cursor, old_node, key, value);
+      leaf_node_pack(&merge, old_node, 0, left_count);
+      leaf_node_pack(&merge, new_node, left_count, total - left_count);
+      leaf_node_split_finish(cursor, old_node, old_max, new_page_num);
+      stats_record_time(TIMER_SPLIT, start);
+      return;
+   }
+  /*
+  All existing keys plus new key should be divided
+  evenly between old (left) and new (right) nodes.
+  Starting from the right, move each key to correct position.
+  */
+   for (int32_t i = table->leaf_node_max_cells; i >= 0; i--) {
+      void* destination_node;
+      if (i >= table->leaf_node_left_split_count) {
+         destination_node = new_node;
+      } else {
+         destination_node = old_node;
+      }
+      uint32_t index_within_node = i % table->leaf_node_left_split_count;
+      void* destination = leaf_node_cell(table, destination_node, index_within_node);
+
+      if (i == cursor->cell_num) {
+         serialize_row(table, value, leaf_node_value(table, destination_node, index_within_node));
+         set_leaf_node_key(table, destination_node, index_within_node, key);
+      } else if (i > cursor->cell_num) {
+         memcpy(destination, leaf_node_cell(table, old_node, i-1), table->leaf_node_cell_size);
+      } else {
+         memcpy(destination, leaf_node_cell(table, old_node, i), table->leaf_node_cell_size);
+      }
+   }
+   /*
+      更新两个叶节点的节点数量
+   */
+  *(leaf_node_num_cells(table, old_node)) = table->leaf_node_left_split_count;
+  *(leaf_node_num_cells(table, new_node)) = table->leaf_node_right_split_count;
+
+  leaf_node_split_finish(cursor, old_node, old_max, new_page_num);
+  stats_record_time(TIMER_SPLIT, start);
+}
+
+/*
+   压缩的叶节点插入：编码不用变时差值数组和 value 数组各自后移一格；
+   新 key 比基准值小或者差值放不下时，换基准值/加宽差值后整个节点重新编码；
+   重新编码后放不下才分裂
+*/
+void leaf_node_insert_packed(Cursor* cursor, void* node, uint64_t key, uint8_t* value) {
+   Table* table = cursor->table;
+   uint32_t num_cells = *leaf_node_num_cells(table, node);
+   uint32_t cell_num = cursor->cell_num;
+   if (num_cells == 0) {
+      set_leaf_node_key_base(table, node, key);
+   }
+   uint64_t base = leaf_node_key_base(table, node);
+   uint32_t width = leaf_node_key_width(table, node);
+   uint64_t min_key = key < base ? key : base;
+   uint64_t max_key = key;
+   if (num_cells > 0 && leaf_node_key(table, node, num_cells - 1) > key) {
+      max_key = leaf_node_key(table, node, num_cells - 1);
+   }
+   uint32_t needed_width = leaf_key_width_for(max_key - min_key);
+
+   if (key >= base && needed_width <= width && num_cells < leaf_node_capacity(table, node)) {
+      void* deltas = leaf_node_key_deltas(table, node);
+      uint32_t row_size = table->schema.row_size;
+      memmove(deltas + (cell_num + 1) * width, deltas + cell_num * width, (num_cells - cell_num) * width);
+      memmove(leaf_node_value(table, node, cell_num + 1), leaf_node_value(table, node, cell_num),
+              (num_cells - cell_num) * row_size);
+      node_write(deltas + cell_num * width, width, key - base);
+      serialize_row(table, value, leaf_node_value(table, node, cell_num));
+      *(leaf_node_num_cells(table, node)) += 1;
+      return;
+   }
+   if (num_cells + 1 <= table->leaf_node_packed_max_cells[needed_width >> 2]) {
+      LeafMerge merge;
+      leaf_merge_begin(&merge, cursor, node, key, value);
+      leaf_node_pack(&merge, node, 0, num_cells + 1);
+      return;
+   }
+   leaf_node_split_and_insert(cursor, key, value);
+}
+
+void leaf_node_insert(Cursor* cursor, uint64_t key, uint8_t* value) {
+   Table* table = cursor->table;
+   void* node = get_page_for_write(cursor->table->pager, cursor->page_num);
+
+   if (table->layout->packed_keys) {
+      leaf_node_insert_packed(cursor, node, key, value);
+      return;
+   }
+
+   uint32_t num_cells = *leaf_node_num_cells(table, node);
+   if (num_cells >= table->leaf_node_max_cells) {
+      //节点满了
+      leaf_node_split_and_insert(cursor, key, value);
+      return;
+   }
+
+   if (cursor->cell_num < num_cells) {
+      //为新cell分配空间，所有cell前移一个单位
+      for (uint32_t i = num_cells; i > cursor->cell_num; i--) {
+         memcpy(leaf_node_cell(table, node, i), leaf_node_cell(table, node, i-1), table->leaf_node_cell_size);
+      }
+   }
+
+   *(leaf_node_num_cells(table, node)) += 1;
+   set_leaf_node_key(table, node, cursor->cell_num, key);
+   serialize_row(table, value, leaf_node_value(table, node, cursor->cell_num));
+}
+
+void indent(uint32_t level) {
+   for (uint32_t i = 0; i < level; i++) {
+      printf("  ");
+   }
+}
+
+//按主键原来的值打印 key
+void print_key(Table* table, const char* prefix, uint64_t key) {
+   if (table->layout->signed_keys) {
+      printf("%s%lld\n", prefix, (long long)(key ^ KEY_SIGN_BIT));
+   } else {
+      printf("%s%llu\n", prefix, (unsigned long long)key);
+   }
+}
+
+void print_tree(Table* table, uint64_t page_num, uint32_t indentation_level) {
+   void* node = get_page(table->pager, page_num);
+   uint32_t num_keys;
+   uint64_t child;
+
+   switch (get_node_type(node)) {
+      case (NODE_LEAF):
+         num_keys = *leaf_node_num_cells(table, node);
+         indent(indentation_level);
+         printf("- leaf (size %d)\n", num_keys);
+         for (uint32_t i = 0; i < num_keys; i++) {
+            indent(indentation_level + 1);
+            print_key(table, "- ", leaf_node_key(table, node, i));
+         }
+         break;
+      case (NODE_INTERNAL):
+         num_keys = *internal_node_num_keys(table, node);
+         indent(indentation_level);
+         printf("- internal (size %d)\n", num_keys);
+         for (uint32_t i = 0; i < num_keys; i++) {
+            child = internal_node_child(table, node, i);
+            print_tree(table, child, indentation_level + 1);
+
+            indent(indentation_level + 1);
+            print_key(table, "- key ", internal_node_key(table, node, i));
+         }
+         child = internal_node_right_child(table, node);
+         print_tree(table, child, indentation_level + 1);
+         break;
+   }
+}
+
+//name 为 NULL 时是默认表
+Table* database_table_or_default(Database* db, const char* name) {
+   return database_find_table(db, name ? name : DEFAULT_TABLE_NAME);
+}
+
+bool db_print_tree(Database* db, const char* table_name) {
+   Table* table = database_table_or_default(db, table_name);
+   if (table == NULL) {
+      return false;
+   }
+   print_tree(table, table->root_page_num, 0);
+   return true;
+}
+
+bool db_print_constants(Database* db, const char* table_name) {
+   Table* table = database_table_or_default(db, table_name);
+   if (table == NULL) {
+      return false;
+   }
+   print_constants(table);
+   return true;
+}
+
+void db_print_tables(Database* db) {
+   for (uint32_t i = 0; i < db->num_tables; i++) {
+      Table* table = db->tables[i];
+      printf("%s (", table->name);
+      for (uint32_t c = 0; c < table->schema.descriptor.num_columns; c++) {
+         ColumnDescriptor* column = &table->schema.descriptor.columns[c];
+         printf("%s%s ", c ? ", " : "", column->name);
+         switch (column->type) {
+            case (COLUMN_INT32):
+               printf("int");
+               break;
+            case (COLUMN_INT64):
+               printf("bigint");
+               break;
+            case (COLUMN_DOUBLE):
+               printf("double");
+               break;
+            case (COLUMN_CHAR):
+               printf("char(%d)", column->length);
+               break;
+            case (COLUMN_VARCHAR):
+               printf("varchar(%d)", column->length);
+               break;
+         }
+      }
+      printf(") root page %llu\n", (unsigned long long)table->root_page_num);
+   }
+}
+
+/*
+   读取 select 当前行的列
+*/
+uint32_t db_column_count(Statement* statement) {
+   return statement->table->schema.descriptor.num_columns;
+}
+
+const char* db_column_name(Statement* statement, uint32_t column) {
+   return statement->table->schema.descriptor.columns[column].name;
+}
+
+ColumnType db_column_type(Statement* statement, uint32_t column) {
+   return (ColumnType)statement->table->schema.descriptor.columns[column].type;
+}
+
+int64_t db_column_int(Statement* statement, uint32_t column) {
+   return row_get_int(&statement->table->schema, statement->row, column);
+}
+
+double db_column_double(Statement* statement, uint32_t column) {
+   return row_get_double(&statement->table->schema, statement->row, column);
+}
+
+const char* db_column_text(Statement* statement, uint32_t column, uint32_t* length) {
+   return row_get_text(&statement->table->schema, statement->row, column, length);
+}
+
+/*
+   统计内部节点，叶节点只数个数，已经在缓存里的顺便数行数。B+树所有叶节点在同一层，
+   树高沿最左边一路走下去就知道，所以叶节点那一层不用读
+*/
+void tree_shape_count(Table* table, uint64_t page_num, uint32_t depth) {
+   TreeShape* shape = &table->shape;
+   if (depth + 1 == shape->height) {
+      shape->leaf_nodes++;
+      void* leaf = pager_cached_page(table->pager, page_num);
+      if (leaf == NULL) {
+         shape->rows_known = false;
+      } else {
+         shape->rows += *leaf_node_num_cells(table, leaf);
+      }
+      return;
+   }
+   void* node = get_page(table->pager, page_num);
+   shape->internal_nodes++;
+   for (uint32_t i = 0; i <= *internal_node_num_keys(table, node); i++) {
+      tree_shape_count(table, internal_node_child(table, node, i), depth + 1);
+   }
+}
+
+/*
+   从文件打开的表还不知道形状时统计一次。只读内部节点(和最左边的一个叶节点)，
+   它们本来就是查找要用的，读的开销不计入统计，免得 .stats 自己改变了它要报告的数字。
+   行数只有在所有叶节点都已经缓存时才数得出来，之后插入时增量维护；数不出来就下次再试
+*/
+void tree_shape_load(Table* table) {
+   if (table->shape_loaded) {
+      return;
+   }
+   StatBlock ignored = {0};
+   StatBlock* saved = stats_redirect(&ignored);
+
+   TreeShape* shape = &table->shape;
+   memset(shape, 0, sizeof(TreeShape));
+   shape->height = 1;
+   void* node = get_page(table->pager, table->root_page_num);
+   while (get_node_type(node) == NODE_INTERNAL) {
+      node = get_page(table->pager, internal_node_child(table, node, 0));
+      shape->height++;
+   }
+   shape->rows_known = true;
+   tree_shape_count(table, table->root_page_num, 0);
+   table->shape_loaded = shape->rows_known;
+
+   stats_redirect(saved);
+}
+
+//压缩的叶节点按最窄的2字节差值时的容量算
+uint32_t table_leaf_capacity(Table* table) {
+   return table->layout->packed_keys ? table->leaf_node_packed_max_cells[0] : table->leaf_node_max_cells;
+}
+
+double lookup_cache_hit_ratio(const StatBlock* total) {
+   uint64_t hits = total->counters[STAT_LOOKUP_CACHE_HIT];
+   uint64_t lookups = hits + total->counters[STAT_LOOKUP_CACHE_MISS];
+   return lookups == 0 ? 0.0 : (double)hits / lookups;
+}
+
+void db_print_stats(Database* db, bool json) {
+   StatBlock total;
+   stats_collect(&total);
+
+   if (json) {
+      printf("{\"format_version\":%u,\"page_size\":%u,\"io_backend\":\"%s\",\"direct_io\":%s,"
+             "\"pages\":%llu,\"lookup_cache_size\":%u,\"lookup_cache_hit_ratio\":%.4f,\"tables\":[",
+             db->format_version, db->pager->page_size,
+             io_backend_name(io_backend(db->pager->io)), db->pager->direct_io ? "true" : "false",
+             (unsigned long long)db->pager->num_pages, db->lookup_cache_size,
+             lookup_cache_hit_ratio(&total));
+   } else {
+      printf("%-16s %u\n", "format_version", db->format_version);
+      printf("%-16s %u\n", "page_size", db->pager->page_size);
+      printf("%-16s %s%s\n", "io_backend", io_backend_name(io_backend(db->pager->io)),
+             db->pager->direct_io ? " (O_DIRECT)" : "");
+      printf("%-16s %llu\n", "pages", (unsigned long long)db->pager->num_pages);
+      if (db->lookup_cache_size > 0) {
+         printf("%-16s %u entries/table, hit ratio %.2f%%\n", "lookup_cache", db->lookup_cache_size,
+                lookup_cache_hit_ratio(&total) * 100);
+      }
+      printf("%-16s %8s %8s %8s %10s %8s\n", "table", "height", "internal", "leaves", "rows", "fill");
+   }
+   for (uint32_t i = 0; i < db->num_tables; i++) {
+      Table* table = db->tables[i];
+      tree_shape_load(table);
+      const TreeShape* shape = &table->shape;
+      double fill_factor = shape->leaf_nodes == 0 ? 0.0 :
+            (double)shape->rows / ((double)shape->leaf_nodes * table_leaf_capacity(table));
+
+      //行数不知道时 rows 和 fill_factor 输出 null / "-"
+      char rows[32] = "null";
+      char fill[32] = "null";
+      if (shape->rows_known) {
+         snprintf(rows, sizeof(rows), "%llu", (unsigned long long)shape->rows);
+         snprintf(fill, sizeof(fill), json ? "%.4f" : "%.2f%%", json ? fill_factor : fill_factor * 100);
+      } else if (!json) {
+         strcpy(rows, "-");
+         strcpy(fill, "-");
+      }
+      if (json) {
+         printf("%s{\"name\":\"%s\",\"height\":%u,\"internal_nodes\":%llu,\"leaf_nodes\":%llu,"
+                "\"rows\":%s,\"fill_factor\":%s}", i ? "," : "", table->name,
+                shape->height, (unsigned long long)shape->internal_nodes,
+                (unsigned long long)shape->leaf_nodes, rows, fill);
+      } else {
+         printf("%-16s %8u %8llu %8llu %10s %8s\n", table->name,
+                shape->height, (unsigned long long)shape->internal_nodes,
+                (unsigned long long)shape->leaf_nodes, rows, fill);
+      }
+   }
+
+   if (json) {
+      printf("],");
+      stats_print(stdout, &total, true);
+      printf("}\n");
+      return;
+   }
+   stats_print(stdout, &total, false);
+}
+
+void db_reset_stats(void) {
+   stats_reset();
+}
@@ -0,0 +1,164 @@
+#ifndef MYDB_H
+#define MYDB_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+//库用 -fvisibility=hidden 编译，只导出标了 DB_API 的接口，内部函数不进动态符号表
+#define DB_API __attribute__((visibility("default")))
+
+/*
+   libmydb 对外接口：
+      Database* db = db_open("file.db");
+      Statement* stmt;
+      db_prepare(db, "select * from users", &stmt);
+      while (db_step(stmt) == EXECUTE_ROW) {
+         int64_t id = db_column_int(stmt, 0);
+         ...
+      }
+      db_finalize(stmt);
+      db_close(db);
+*/
+
+//默认schema (id int, username char(32), email char(255))，即原来写死的 Row
+#define COLUMN_USERNAME_SIZE 32
+#define COLUMN_EMAIL_SIZE 255
+
+typedef struct Database Database;   //数据库句柄，一个db文件可以有多张表
+typedef struct Statement Statement; //预编译后的语句
+
+typedef enum {
+   COLUMN_INT32,
+   COLUMN_INT64,
+   COLUMN_DOUBLE,
+   COLUMN_CHAR,      //char(n)：定长n字节
+   COLUMN_VARCHAR    //varchar(n)：2字节长度 + 最多n字节
+} ColumnType;
+//行在叶节点里是定长的：varchar(n) 不管存多短的字符串都占 2+n 字节的槽位，
+//和 char(n) 比只省了填充0和去尾的开销，不省空间；n 同样计入行大小上限
+
+typedef enum {
+   PREPARE_SUCCESS,
+   PREPARE_SYNTAX_ERROR,
+   PREPARE_UNRECOGNIZED_STATEMENT,
+   PREPARE_STRING_TOO_LONG,
+   PREPARE_INVALID_SCHEMA,
+   PREPARE_UNKNOWN_TABLE,
+   PREPARE_NEGATIVE_KEY    //版本6之前的文件不能插入负主键
+} PrepareResult;
+
+typedef enum {
+   EXECUTE_SUCCESS,     //语句执行完毕
+   EXECUTE_ROW,         //select 产出了一行，继续 db_step 取下一行
+   EXECUTE_DUPLICATE_KEY,
+   EXECUTE_TABLE_FULL,
+   EXECUTE_TABLE_EXISTS,
+   EXECUTE_LEGACY_FORMAT,  //旧格式文件只有一张表，不能新建表
+   EXECUTE_DB_ERROR        //读写出错或发现文件损坏(见 db_error)，之后的语句都会失败，只能关闭
+} ExecuteResult;
+
+/*
+   打开、关闭db文件和执行语句时遇到的文件错误。库不会因为这些错误退出进程，
+   由调用者决定怎么报告
+*/
+typedef enum {
+   DB_OK,
+   DB_ERROR_OPEN,        //打不开或建不了db文件
+   DB_ERROR_PAGE_SIZE,   //页大小不是 DB_MIN_PAGE_SIZE ~ DB_MAX_PAGE_SIZE 之间的2的幂
+   DB_ERROR_CORRUPT,     //文件大小、文件头、系统表或页号损坏
+   DB_ERROR_VERSION,     //不支持的文件格式版本
+   DB_ERROR_IO           //读写文件出错
+} DbResult;
+
+/*
+   新建db文件时的选项，打开已有文件时以文件头为准
+*/
+#define DB_DEFAULT_PAGE_SIZE 4096
+#define DB_MIN_PAGE_SIZE 4096
+#define DB_MAX_PAGE_SIZE 65536
+#define DB_MAX_LOOKUP_CACHE_SIZE (1u << 20) //每张表点查询缓存项数的上限，更大的值按上限处理
+
+typedef enum {
+   DB_IO_SYNC,      //每页一次 pread/pwrite
+   DB_IO_URING,     //io_uring 批量提交，内核不支持时退回线程池
+   DB_IO_THREADS    //线程池
+} DbIoBackend;
+
+typedef struct {
+   uint32_t page_size;  //2的幂，DB_MIN_PAGE_SIZE ~ DB_MAX_PAGE_SIZE
+   DbIoBackend io_backend;
+   bool direct_io;      //尝试 O_DIRECT 绕过系统页缓存，文件系统不支持时忽略
+   bool huge_pages;     //页帧所在的内存块尝试使用大页，减少 TLB 未命中
+   uint32_t lookup_cache_size; //每张表主键点查询缓存的项数，0 表示不缓存，最多 DB_MAX_LOOKUP_CACHE_SIZE
+} DatabaseOptions;
+
+DB_API void db_default_options(DatabaseOptions* options);
+//打开(或新建)一个db文件，新文件里有一张默认schema的表 main。出错时返回 NULL
+DB_API Database* db_open(const char* filename);
+//同上，出错时返回错误，*db 为 NULL
+DB_API DbResult db_open_with_options(const char* filename, const DatabaseOptions* options, Database** db);
+//把所有缓存页写回磁盘并释放句柄。写回失败也会释放句柄，返回 DB_ERROR_IO；
+//之前出过错的句柄不再写文件，返回那个错误
+DB_API DbResult db_close(Database* db);
+//第一次遇到的文件错误，没有出错时是 DB_OK
+DB_API DbResult db_error(Database* db);
+
+//解析一条语句，成功时 *statement 指向新分配的语句，用完需 db_finalize
+//支持：
+//   insert [into <表名>] <值...>
+//   select [* from <表名> [where <主键列> = <值>]]
+//   create table <表名> (<列名> <类型>, ...)
+//不写表名时操作 main 表
+DB_API PrepareResult db_prepare(Database* db, const char* sql, Statement** statement);
+//推进语句一步：insert/create 直接执行完；select 每次产出一行，用 db_column_* 读取
+DB_API ExecuteResult db_step(Statement* statement);
+//释放语句及其持有的光标
+DB_API void db_finalize(Statement* statement);
+
+//读取 select 当前行的列，列号从0开始，第0列是主键
+DB_API uint32_t db_column_count(Statement* statement);
+DB_API const char* db_column_name(Statement* statement, uint32_t column);
+DB_API ColumnType db_column_type(Statement* statement, uint32_t column);
+DB_API int64_t db_column_int(Statement* statement, uint32_t column);
+DB_API double db_column_double(Statement* statement, uint32_t column);
+//char/varchar 列，返回的字符串不一定以0结尾，长度写入 *length
+DB_API const char* db_column_text(Statement* statement, uint32_t column, uint32_t* length);
+
+//调试输出，table_name 为 NULL 时是 main 表，表不存在返回 false
+DB_API bool db_print_tree(Database* db, const char* table_name);
+DB_API bool db_print_constants(Database* db, const char* table_name);
+DB_API void db_print_tables(Database* db);
+
+/*
+   在线备份：把调用这一刻的db文件一致地拷贝到 path。拷贝在后台线程进行，期间可以继续执行语句，
+   修改只留在内存里，等备份结束后才会写回db文件。同一时间只有一个备份，db_close 会等它结束
+*/
+typedef enum {
+   BACKUP_STARTED,
+   BACKUP_BUSY,          //上一个备份还没结束，或者它的结果还没用 db_backup_status 取走
+   BACKUP_OPEN_FAILED,   //打不开备份文件
+   BACKUP_SAME_FILE,     //备份文件就是db文件本身，拒绝覆盖
+   BACKUP_THREAD_FAILED, //起不了后台线程
+   BACKUP_DB_ERROR       //写回脏页失败，或者句柄之前出过错(见 db_error)
+} BackupResult;
+
+typedef enum {
+   BACKUP_IDLE,
+   BACKUP_RUNNING,
+   BACKUP_FINISHED,
+   BACKUP_FAILED
+} BackupState;
+
+//开始时 *total_pages 是要拷贝的页数
+DB_API BackupResult db_backup(Database* db, const char* path, uint64_t* total_pages);
+//备份进度(按页计)。结束的备份在这里回收，FINISHED/FAILED 只报告一次，之后是 IDLE
+DB_API BackupState db_backup_status(Database* db, uint64_t* copied_pages, uint64_t* total_pages);
+
+//运行时统计：页缓存命中、系统调用、分裂次数、树形状以及各路径的耗时直方图
+//json 为 true 时输出一行 JSON，便于程序解析。
+//计数器和耗时是整个进程的：同一进程里打开多个 Database 时计的是它们的总和，db_reset_stats 也会一起清零；
+//只有文件格式、页数、树形状这些是 db 自己的
+DB_API void db_print_stats(Database* db, bool json);
+DB_API void db_reset_stats(void);
+
+#endif
@@ -0,0 +1,304 @@
+#include <ctype.h>
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "schema.h"
+
+void schema_default(SchemaDescriptor* descriptor) {
+   memset(descriptor, 0, sizeof(SchemaDescriptor));
+   descriptor->num_columns = 3;
+   strcpy(descriptor->columns[0].name, "id");
+   descriptor->columns[0].type = COLUMN_INT32;
+   strcpy(descriptor->columns[1].name, "username");
+   descriptor->columns[1].type = COLUMN_CHAR;
+   descriptor->columns[1].length = COLUMN_USERNAME_SIZE;
+   strcpy(descriptor->columns[2].name, "email");
+   descriptor->columns[2].type = COLUMN_CHAR;
+   descriptor->columns[2].length = COLUMN_EMAIL_SIZE;
+}
+
+static const char* skip_spaces(const char* p) {
+   while (isspace((unsigned char)*p)) {
+      p++;
+   }
+   return p;
+}
+
+//读一个标识符到 out，返回标识符之后的位置，失败返回NULL
+static const char* parse_identifier(const char* p, char* out, size_t out_size) {
+   size_t length = 0;
+   while (isalnum((unsigned char)p[length]) || p[length] == '_') {
+      length++;
+   }
+   if (length == 0 || length >= out_size) {
+      return NULL;
+   }
+   memcpy(out, p, length);
+   out[length] = 0;
+   return p + length;
+}
+
+//解析 "(n)"，返回之后的位置
+static const char* parse_length(const char* p, uint16_t* length) {
+   p = skip_spaces(p);
+   if (*p != '(') {
+      return NULL;
+   }
+   char* end;
+   long value = strtol(p + 1, &end, 10);
+   end = (char*)skip_spaces(end);
+   if (end == p + 1 || *end != ')' || value <= 0 || value > ROW_MAX_SIZE) {
+      return NULL;
+   }
+   *length = (uint16_t)value;
+   return end + 1;
+}
+
+SchemaResult schema_parse(const char* text, SchemaDescriptor* descriptor) {
+   memset(descriptor, 0, sizeof(SchemaDescriptor));
+
+   const char* p = skip_spaces(text);
+   if (*p != '(') {
+      return SCHEMA_SYNTAX_ERROR;
+   }
+   p++;
+
+   while (true) {
+      if (descriptor->num_columns == SCHEMA_MAX_COLUMNS) {
+         return SCHEMA_TOO_MANY_COLUMNS;
+      }
+      ColumnDescriptor* column = &descriptor->columns[descriptor->num_columns];
+
+      p = parse_identifier(skip_spaces(p), column->name, COLUMN_NAME_SIZE);
+      if (p == NULL) {
+         return SCHEMA_SYNTAX_ERROR;
+      }
+      for (uint32_t i = 0; i < descriptor->num_columns; i++) {
+         if (strcmp(descriptor->columns[i].name, column->name) == 0) {
+            return SCHEMA_SYNTAX_ERROR; //列名重复
+         }
+      }
+
+      char type_name[16];
+      p = parse_identifier(skip_spaces(p), type_name, sizeof(type_name));
+      if (p == NULL) {
+         return SCHEMA_SYNTAX_ERROR;
+      }
+      if (strcmp(type_name, "int") == 0 || strcmp(type_name, "int32") == 0) {
+         column->type = COLUMN_INT32;
+      } else if (strcmp(type_name, "bigint") == 0 || strcmp(type_name, "int64") == 0) {
+         column->type = COLUMN_INT64;
+      } else if (strcmp(type_name, "double") == 0) {
+         column->type = COLUMN_DOUBLE;
+      } else if (strcmp(type_name, "char") == 0) {
+         column->type = COLUMN_CHAR;
+         p = parse_length(p, &column->length);
+      } else if (strcmp(type_name, "varchar") == 0) {
+         column->type = COLUMN_VARCHAR;
+         p = parse_length(p, &column->length);
+      } else {
+         return SCHEMA_SYNTAX_ERROR;
+      }
+      if (p == NULL) {
+         return SCHEMA_SYNTAX_ERROR;
+      }
+      descriptor->num_columns++;
+
+      p = skip_spaces(p);
+      if (*p == ',') {
+         p++;
+         continue;
+      }
+      if (*p != ')' || *skip_spaces(p + 1) != 0) {
+         return SCHEMA_SYNTAX_ERROR;
+      }
+      return SCHEMA_SUCCESS;
+   }
+}
+
+SchemaResult schema_compile(const SchemaDescriptor* descriptor, Schema* schema) {
+   if (descriptor->num_columns == 0) {
+      return SCHEMA_SYNTAX_ERROR;
+   }
+   if (descriptor->num_columns > SCHEMA_MAX_COLUMNS) {
+      return SCHEMA_TOO_MANY_COLUMNS;
+   }
+   if (descriptor->columns[0].type != COLUMN_INT32 && descriptor->columns[0].type != COLUMN_INT64) {
+      return SCHEMA_BAD_PRIMARY_KEY;
+   }
+
+   schema->descriptor = *descriptor;
+   uint32_t offset = 0;
+   for (uint32_t i = 0; i < descriptor->num_columns; i++) {
+      const ColumnDescriptor* column = &descriptor->columns[i];
+      uint32_t size;
+      switch (column->type) {
+         case (COLUMN_INT32):
+            size = sizeof(int32_t);
+            break;
+         case (COLUMN_INT64):
+            size = sizeof(int64_t);
+            break;
+         case (COLUMN_DOUBLE):
+            size = sizeof(double);
+            break;
+         case (COLUMN_CHAR):
+            size = column->length;
+            break;
+         case (COLUMN_VARCHAR):
+            size = sizeof(uint16_t) + column->length; //长度前缀 + 内容，按最大长度留槽位
+            break;
+         default:
+            return SCHEMA_SYNTAX_ERROR;
+      }
+      schema->offsets[i] = offset;
+      schema->sizes[i] = size;
+      offset += size;
+      if (offset > ROW_MAX_SIZE) {
+         return SCHEMA_ROW_TOO_LARGE;
+      }
+   }
+   schema->row_size = offset;
+   return SCHEMA_SUCCESS;
+}
+
+PrepareResult row_parse(const Schema* schema, const char* values, uint8_t* row) {
+   memset(row, 0, schema->row_size);
+
+   const char* p = values;
+   for (uint32_t i = 0; i < schema->descriptor.num_columns; i++) {
+      const ColumnDescriptor* column = &schema->descriptor.columns[i];
+      uint8_t* destination = row + schema->offsets[i];
+
+      p = skip_spaces(p);
+      size_t length = 0;
+      while (p[length] != 0 && !isspace((unsigned char)p[length])) {
+         length++;
+      }
+      if (length == 0) {
+         return PREPARE_SYNTAX_ERROR;
+      }
+
+      char* end;
+      errno = 0;
+      switch (column->type) {
+         case (COLUMN_INT32): {
+            long long value = strtoll(p, &end, 10);
+            if (end != p + length || errno != 0 || value < INT32_MIN || value > INT32_MAX) {
+               return PREPARE_SYNTAX_ERROR;
+            }
+            int32_t v = (int32_t)value;
+            memcpy(destination, &v, sizeof(v));
+            break;
+         }
+         case (COLUMN_INT64): {
+            long long value = strtoll(p, &end, 10);
+            if (end != p + length || errno != 0) {
+               return PREPARE_SYNTAX_ERROR;
+            }
+            int64_t v = value;
+            memcpy(destination, &v, sizeof(v));
+            break;
+         }
+         case (COLUMN_DOUBLE): {
+            double value = strtod(p, &end);
+            if (end != p + length || errno != 0) {
+               return PREPARE_SYNTAX_ERROR;
+            }
+            memcpy(destination, &value, sizeof(value));
+            break;
+         }
+         case (COLUMN_CHAR):
+            if (length > column->length) {
+               return PREPARE_STRING_TOO_LONG;
+            }
+            memcpy(destination, p, length);
+            break;
+         case (COLUMN_VARCHAR): {
+            if (length > column->length) {
+               return PREPARE_STRING_TOO_LONG;
+            }
+            uint16_t stored = (uint16_t)length;
+            memcpy(destination, &stored, sizeof(stored));
+            memcpy(destination + sizeof(stored), p, length);
+            break;
+         }
+      }
+      p += length;
+   }
+
+   if (*skip_spaces(p) != 0) {
+      return PREPARE_SYNTAX_ERROR; //值比列多
+   }
+   return PREPARE_SUCCESS;
+}
+
+uint64_t row_key(const Schema* schema, const uint8_t* row) {
+   return (uint64_t)row_get_int(schema, row, 0);
+}
+
+int64_t row_get_int(const Schema* schema, const uint8_t* row, uint32_t column) {
+   const uint8_t* source = row + schema->offsets[column];
+   switch (schema->descriptor.columns[column].type) {
+      case (COLUMN_INT32): {
+         int32_t value;
+         memcpy(&value, source, sizeof(value));
+         return value;
+      }
+      case (COLUMN_INT64): {
+         int64_t value;
+         memcpy(&value, source, sizeof(value));
+         return value;
+      }
+      case (COLUMN_DOUBLE):
+         return (int64_t)row_get_double(schema, row, column);
+      default:
+         return 0;
+   }
+}
+
+void row_set_int(const Schema* schema, uint8_t* row, uint32_t column, int64_t value) {
+   uint8_t* destination = row + schema->offsets[column];
+   if (schema->descriptor.columns[column].type == COLUMN_INT32) {
+      int32_t narrow = (int32_t)value;
+      memcpy(destination, &narrow, sizeof(narrow));
+   } else {
+      memcpy(destination, &value, sizeof(value));
+   }
+}
+
+double row_get_double(const Schema* schema, const uint8_t* row, uint32_t column) {
+   const uint8_t* source = row + schema->offsets[column];
+   if (schema->descriptor.columns[column].type == COLUMN_DOUBLE) {
+      double value;
+      memcpy(&value, source, sizeof(value));
+      return value;
+   }
+   return (double)row_get_int(schema, row, column);
+}
+
+const char* row_get_text(const Schema* schema, const uint8_t* row, uint32_t column, uint32_t* length) {
+   const uint8_t* source = row + schema->offsets[column];
+   const ColumnDescriptor* descriptor = &schema->descriptor.columns[column];
+   switch (descriptor->type) {
+      case (COLUMN_CHAR): {
+         const char* text = (const char*)source;
+         uint32_t n = 0;
+         while (n < descriptor->length && text[n] != 0) {
+            n++;
+         }
+         *length = n;
+         return text;
+      }
+      case (COLUMN_VARCHAR): {
+         uint16_t stored;
+         memcpy(&stored, source, sizeof(stored));
+         *length = stored;
+         return (const char*)(source + sizeof(stored));
+      }
+      default:
+         *length = 0;
+         return NULL;
+   }
+}
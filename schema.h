@@ -0,0 +1,64 @@
+#ifndef MYDB_SCHEMA_H
+#define MYDB_SCHEMA_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "mydb.h"
+
+#define COLUMN_NAME_SIZE 32
+#define SCHEMA_MAX_COLUMNS 16
+#define ROW_MAX_SIZE 1024 //一页至少要能放下3个cell，分裂才有意义
+
+/*
+   列描述符，原样保存在db文件里
+*/
+typedef struct {
+   char name[COLUMN_NAME_SIZE];
+   uint8_t type;       //ColumnType
+   uint8_t reserved;
+   uint16_t length;    //char(n)/varchar(n) 的 n，数值类型为0
+} ColumnDescriptor;
+
+typedef struct {
+   uint32_t num_columns;
+   ColumnDescriptor columns[SCHEMA_MAX_COLUMNS];
+} SchemaDescriptor;
+
+/*
+   由描述符编译出来的行布局：每一列在行里的偏移和大小。
+   行在内存里和在页里是同一种布局，所以(反)序列化一行只需要一次 memcpy
+*/
+typedef struct {
+   SchemaDescriptor descriptor;
+   uint16_t offsets[SCHEMA_MAX_COLUMNS];
+   uint16_t sizes[SCHEMA_MAX_COLUMNS];
+   uint32_t row_size;
+} Schema;
+
+typedef enum {
+   SCHEMA_SUCCESS,
+   SCHEMA_SYNTAX_ERROR,
+   SCHEMA_TOO_MANY_COLUMNS,
+   SCHEMA_ROW_TOO_LARGE,
+   SCHEMA_BAD_PRIMARY_KEY  //第一列是主键，必须是 int 或 bigint
+} SchemaResult;
+
+//原来写死的 Row：(id int32, username char(32), email char(255))
+void schema_default(SchemaDescriptor* descriptor);
+//解析 "(id int, name varchar(32), score double)"
+SchemaResult schema_parse(const char* text, SchemaDescriptor* descriptor);
+//计算每列的偏移和行大小
+SchemaResult schema_compile(const SchemaDescriptor* descriptor, Schema* schema);
+
+//按 schema 把空格分隔的值解析成一行
+PrepareResult row_parse(const Schema* schema, const char* values, uint8_t* row);
+uint64_t row_key(const Schema* schema, const uint8_t* row);
+
+int64_t row_get_int(const Schema* schema, const uint8_t* row, uint32_t column);
+//只用于 int/bigint 列
+void row_set_int(const Schema* schema, uint8_t* row, uint32_t column, int64_t value);
+double row_get_double(const Schema* schema, const uint8_t* row, uint32_t column);
+const char* row_get_text(const Schema* schema, const uint8_t* row, uint32_t column, uint32_t* length);
+
+#endif
@@ -0,0 +1,208 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "stats.h"
+
+__thread StatBlock* stats_thread_block = NULL;
+
+static StatBlock* all_blocks = NULL;
+static StatBlock retired_total; //已退出线程的计数，all_blocks_lock 保护
+static pthread_mutex_t all_blocks_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_key_t thread_exit_key;
+static pthread_once_t thread_exit_key_once = PTHREAD_ONCE_INIT;
+
+static const char* counter_names[STAT_COUNTER_COUNT] = {
+   "page_hits",
+   "page_misses",
+   "read_syscalls",
+   "write_syscalls",
+   "pages_read",
+   "pages_written",
+   "pages_prefetched",
+   "leaf_splits",
+   "internal_splits",
+   "root_splits",
+   "rows_inserted",
+   "rows_read",
+   "heap_allocations",
+   "arena_chunks",
+   "lookup_hits",
+   "lookup_misses",
+   "backup_pages",
+};
+
+static const char* timer_names[STAT_TIMER_COUNT] = {
+   "pager_read",
+   "pager_flush",
+   "search",
+   "split",
+   "prepare",
+};
+
+static void stats_add_block(StatBlock* total, const StatBlock* block) {
+   for (uint32_t i = 0; i < STAT_COUNTER_COUNT; i++) {
+      total->counters[i] += block->counters[i];
+   }
+   for (uint32_t t = 0; t < STAT_TIMER_COUNT; t++) {
+      total->timer_count[t] += block->timer_count[t];
+      total->timer_total_ns[t] += block->timer_total_ns[t];
+      for (uint32_t b = 0; b < STAT_HISTOGRAM_BUCKETS; b++) {
+         total->histogram[t][b] += block->histogram[t][b];
+      }
+   }
+}
+
+/*
+   线程退出时把它的计数并进 retired_total，再从链表上摘下释放，
+   反复起停的线程(比如每次备份一个)不会让链表一直变长
+*/
+static void stats_retire_thread(void* argument) {
+   StatBlock* block = argument;
+   pthread_mutex_lock(&all_blocks_lock);
+   stats_add_block(&retired_total, block);
+   StatBlock** link = &all_blocks;
+   while (*link != block) {
+      link = &(*link)->next;
+   }
+   *link = block->next;
+   pthread_mutex_unlock(&all_blocks_lock);
+
+   stats_thread_block = NULL;
+   free(block);
+}
+
+static void stats_create_thread_exit_key(void) {
+   pthread_key_create(&thread_exit_key, stats_retire_thread);
+}
+
+/*
+   线程第一次计数时分配自己的 StatBlock 并挂到全局链表上，退出时由 stats_retire_thread 回收
+*/
+StatBlock* stats_register_thread(void) {
+   StatBlock* block = calloc(1, sizeof(StatBlock));
+   if (block == NULL) {
+      printf("Error allocating stats block\n");
+      exit(EXIT_FAILURE);
+   }
+
+   pthread_mutex_lock(&all_blocks_lock);
+   block->next = all_blocks;
+   all_blocks = block;
+   pthread_mutex_unlock(&all_blocks_lock);
+
+   pthread_once(&thread_exit_key_once, stats_create_thread_exit_key);
+   pthread_setspecific(thread_exit_key, block);
+   stats_thread_block = block;
+   return block;
+}
+
+StatBlock* stats_redirect(StatBlock* block) {
+   StatBlock* previous = STATS_LOCAL();
+   stats_thread_block = block;
+   return previous;
+}
+
+uint64_t stats_now_ns(void) {
+   struct timespec ts;
+   clock_gettime(CLOCK_MONOTONIC, &ts);
+   return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+void stats_record_time(StatTimer timer, uint64_t start_ns) {
+   uint64_t elapsed = stats_now_ns() - start_ns;
+   StatBlock* block = STATS_LOCAL();
+
+   uint32_t bucket = 0;
+   while (bucket + 1 < STAT_HISTOGRAM_BUCKETS && (elapsed >> (bucket + 1)) != 0) {
+      bucket++;
+   }
+
+   block->timer_count[timer]++;
+   block->timer_total_ns[timer] += elapsed;
+   block->histogram[timer][bucket]++;
+}
+
+void stats_collect(StatBlock* total) {
+   memset(total, 0, sizeof(StatBlock));
+
+   pthread_mutex_lock(&all_blocks_lock);
+   stats_add_block(total, &retired_total);
+   for (StatBlock* block = all_blocks; block != NULL; block = block->next) {
+      stats_add_block(total, block);
+   }
+   pthread_mutex_unlock(&all_blocks_lock);
+}
+
+void stats_reset(void) {
+   pthread_mutex_lock(&all_blocks_lock);
+   memset(&retired_total, 0, sizeof(StatBlock));
+   for (StatBlock* block = all_blocks; block != NULL; block = block->next) {
+      StatBlock* next = block->next;
+      memset(block, 0, sizeof(StatBlock));
+      block->next = next;
+   }
+   pthread_mutex_unlock(&all_blocks_lock);
+}
+
+/*
+   根据直方图估算分位数，返回所在桶的上界(纳秒)
+*/
+static uint64_t histogram_percentile(const StatBlock* total, StatTimer timer, double percentile) {
+   uint64_t count = total->timer_count[timer];
+   if (count == 0) {
+      return 0;
+   }
+
+   uint64_t rank = (uint64_t)(count * percentile);
+   if (rank >= count) {
+      rank = count - 1;
+   }
+   uint64_t seen = 0;
+   for (uint32_t b = 0; b < STAT_HISTOGRAM_BUCKETS; b++) {
+      seen += total->histogram[timer][b];
+      if (seen > rank) {
+         return 1ull << (b + 1);
+      }
+   }
+   return 1ull << STAT_HISTOGRAM_BUCKETS;
+}
+
+void stats_print(FILE* out, const StatBlock* total, bool json) {
+   if (json) {
+      fprintf(out, "\"counters\":{");
+      for (uint32_t i = 0; i < STAT_COUNTER_COUNT; i++) {
+         fprintf(out, "%s\"%s\":%llu", i ? "," : "", counter_names[i],
+                 (unsigned long long)total->counters[i]);
+      }
+      fprintf(out, "},\"timers\":{");
+      for (uint32_t t = 0; t < STAT_TIMER_COUNT; t++) {
+         fprintf(out, "%s\"%s\":{\"count\":%llu,\"total_ns\":%llu,\"histogram\":[", t ? "," : "",
+                 timer_names[t],
+                 (unsigned long long)total->timer_count[t],
+                 (unsigned long long)total->timer_total_ns[t]);
+         for (uint32_t b = 0; b < STAT_HISTOGRAM_BUCKETS; b++) {
+            fprintf(out, "%s%llu", b ? "," : "", (unsigned long long)total->histogram[t][b]);
+         }
+         fprintf(out, "]}");
+      }
+      fprintf(out, "}");
+      return;
+   }
+
+   for (uint32_t i = 0; i < STAT_COUNTER_COUNT; i++) {
+      fprintf(out, "%-16s %llu\n", counter_names[i], (unsigned long long)total->counters[i]);
+   }
+   fprintf(out, "%-16s %10s %10s %10s %10s\n", "timer", "count", "avg_ns", "p50_ns", "p99_ns");
+   for (uint32_t t = 0; t < STAT_TIMER_COUNT; t++) {
+      uint64_t count = total->timer_count[t];
+      fprintf(out, "%-16s %10llu %10llu %10llu %10llu\n", timer_names[t],
+              (unsigned long long)count,
+              (unsigned long long)(count ? total->timer_total_ns[t] / count : 0),
+              (unsigned long long)histogram_percentile(total, t, 0.50),
+              (unsigned long long)histogram_percentile(total, t, 0.99));
+   }
+}
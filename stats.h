@@ -0,0 +1,74 @@
+#ifndef MYDB_STATS_H
+#define MYDB_STATS_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+/*
+   运行时统计：每个线程写自己的 StatBlock，不加锁；
+   读取时(.stats)把所有线程的 StatBlock 累加起来。线程退出时计数并入一份总数，StatBlock 随即释放。
+   计数是整个进程共用的，不区分是哪个 Database
+*/
+
+typedef enum {
+   STAT_PAGE_HIT,          //get_page 命中缓存
+   STAT_PAGE_MISS,         //get_page 未命中
+   STAT_READ_SYSCALL,      //读页的系统调用次数(pread 或 io_uring_enter)
+   STAT_WRITE_SYSCALL,     //写页的系统调用次数
+   STAT_PAGES_READ,        //从磁盘读入的页
+   STAT_PAGES_WRITTEN,     //写回磁盘的页
+   STAT_PAGES_PREFETCHED,  //扫描时预读的页
+   STAT_LEAF_SPLIT,        //叶节点分裂
+   STAT_INTERNAL_SPLIT,    //内部节点分裂
+   STAT_ROOT_SPLIT,        //根节点分裂(树高+1)
+   STAT_ROWS_INSERTED,
+   STAT_ROWS_READ,
+   STAT_HEAP_ALLOCATIONS,  //引擎里的 malloc/realloc 次数
+   STAT_ARENA_CHUNKS,      //页帧分配器向系统申请的内存块
+   STAT_LOOKUP_CACHE_HIT,  //点查询直接从缓存定位，不用从根查找
+   STAT_LOOKUP_CACHE_MISS,
+   STAT_BACKUP_PAGES,      //在线备份拷贝的页
+   STAT_COUNTER_COUNT
+} StatCounter;
+
+typedef enum {
+   TIMER_PAGER_READ,       //缓存未命中时从磁盘加载(一页或一批预读)
+   TIMER_PAGER_FLUSH,      //写回所有脏页
+   TIMER_SEARCH,           //table_find 从根下降到叶
+   TIMER_SPLIT,            //leaf_node_split_and_insert
+   TIMER_PREPARE,          //解析语句
+   STAT_TIMER_COUNT
+} StatTimer;
+
+//第 i 个桶记录耗时在 [2^i, 2^(i+1)) 纳秒之间的次数
+#define STAT_HISTOGRAM_BUCKETS 32
+
+typedef struct StatBlock {
+   uint64_t counters[STAT_COUNTER_COUNT];
+   uint64_t timer_count[STAT_TIMER_COUNT];
+   uint64_t timer_total_ns[STAT_TIMER_COUNT];
+   uint64_t histogram[STAT_TIMER_COUNT][STAT_HISTOGRAM_BUCKETS];
+   struct StatBlock* next; //所有线程的 StatBlock 串成链表，读取时遍历
+} StatBlock;
+
+extern __thread StatBlock* stats_thread_block;
+StatBlock* stats_register_thread(void);
+
+#define STATS_LOCAL() (stats_thread_block ? stats_thread_block : stats_register_thread())
+//本线程之后的计数改记到 block(不计入总数)，返回原来的 StatBlock，用它再调一次就恢复
+StatBlock* stats_redirect(StatBlock* block);
+#define STAT_INC(counter) (STATS_LOCAL()->counters[(counter)]++)
+#define STAT_ADD(counter, n) (STATS_LOCAL()->counters[(counter)] += (n))
+
+uint64_t stats_now_ns(void);
+//记录一次从 start_ns 到现在的耗时
+void stats_record_time(StatTimer timer, uint64_t start_ns);
+
+//把所有线程(包括已退出的)的计数累加到 total
+void stats_collect(StatBlock* total);
+void stats_reset(void);
+//json 为 true 时输出一行 JSON 对象的字段(不含外层花括号)，否则输出可读文本
+void stats_print(FILE* out, const StatBlock* total, bool json);
+
+#endif